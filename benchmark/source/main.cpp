@@ -8,8 +8,20 @@
 #include <mutex>
 #include <numeric>
 #include <retlock/retlock.hpp>
+#include <retlock/retlock_basic.hpp>
+#include <retlock/retlock_biased.hpp>
+#include <retlock/retlock_clh.hpp>
+#include <retlock/retlock_cohort.hpp>
+#include <retlock/retlock_combining.hpp>
+#include <retlock/retlock_futex.hpp>
+#include <retlock/retlock_hybrid.hpp>
+#include <retlock/retlock_malthusian.hpp>
+#include <retlock/retlock_outofline.hpp>
+#include <retlock/retlock_qspin.hpp>
 #include <retlock/retlock_queue.hpp>
 #include <retlock/retlock_sameline.hpp>
+#include <retlock/retlock_thin.hpp>
+#include <retlock/retlock_ticket.hpp>
 #include <string>
 #include <thread>
 #include <type_traits>
@@ -30,8 +42,21 @@ struct Config {
   size_t iteration;
   size_t duration;
   bool back_and_forth;
+  size_t oversubscription;
 };
 
+// nests `depth` execute() calls and accesses the shared variables in the innermost one
+template <typename LockType> void nested_execute(LockType* lock, size_t depth) {
+  lock->execute([&] {
+    if (depth <= 1) {
+      shared_variable.foo++;
+      shared_variable.bar++;
+    } else {
+      nested_execute(lock, depth - 1);
+    }
+  });
+}
+
 template <typename LockType> void reentrant_worker(LockType* lock, Config c, int* local_counter) {
   while (!start_benchmark.load()) {
     std::this_thread::yield();
@@ -48,6 +73,23 @@ template <typename LockType> void reentrant_worker(LockType* lock, Config c, int
       (*local_counter)++;
       continue;
     }
+    // For combining locks: delegate the critical section via execute()
+    if constexpr (requires { lock->execute([] {}); }) {
+      if (c.back_and_forth) {
+        lock->execute([&] {
+          for (int i = 0; i < c.iteration; ++i) {
+            lock->execute([] {
+              shared_variable.foo++;
+              shared_variable.bar++;
+            });
+          }
+        });
+      } else {
+        nested_execute(lock, c.iteration);
+      }
+      (*local_counter)++;
+      continue;
+    }
     if (c.back_and_forth) {
       lock->lock();
 
@@ -156,20 +198,49 @@ void work(Config c) {
   benchmark<std::recursive_mutex>(c, "std::recursive_mutex");
   benchmark<retlock::ReTLockQueue>(c, "MCS");
   benchmark<retlock::ReTLockQueueAFS>(c, "MCS+Adap");
+  benchmark<retlock::ReTLockQueueCNA>(c, "MCS+CNA");
+  benchmark<retlock::ReTLockQueuePark>(c, "MCS+Park");
+  benchmark<retlock::ReTLockQueueTP>(c, "MCS+TP");
+  benchmark<retlock::ReTLockCLH>(c, "CLH");
+  benchmark<retlock::ReTLockCLHAFS>(c, "CLH+Adap");
+  benchmark<retlock::ReTLockTicket>(c, "Ticket");
+  benchmark<retlock::ReTLockFutex>(c, "Futex");
+  benchmark<retlock::ReTLockQSpin>(c, "QSpin");
+  benchmark<retlock::ReTLockThin>(c, "Thin");
+  benchmark<retlock::ReTLockHybrid>(c, "Hybrid");
+  benchmark<retlock::ReTLockCohort>(c, "Cohort");
+  benchmark<retlock::CombiningLock>(c, "Combining");
   benchmark<retlock::ReTLockVanilla>(c, "Exponential");
   benchmark<retlock::ReTLockSameLineNoSleep>(c, "NoSleep");
   benchmark<retlock::ReTLockSameLineYield>(c, "Yield");
   benchmark<retlock::ReTLockSameLineYield>(c, "Adaptive");
+  benchmark<retlock::ReTLockSameLinePause>(c, "Pause");
   benchmark<retlock::ReTLockPadding>(c, "Exp+Padding");
   benchmark<retlock::ReTLockYieldPadding>(c, "Yie+Padding");
   benchmark<retlock::ReTLockAdaptivePadding>(c, "Adap+Padding");
   benchmark<retlock::ReTLockNoSleepPadding>(c, "NoSl+Padding");
+  benchmark<retlock::ReTLockPausePadding>(c, "Pause+Padding");
+  benchmark<retlock::ReTLockOutOfLine>(c, "Exp+OutOfLine");
+  benchmark<retlock::ReTLockOutOfLineYield>(c, "Yie+OutOfLine");
+  benchmark<retlock::ReTLockOutOfLineNoSleep>(c, "NoSl+OutOfLine");
+  benchmark<retlock::ReTLockOutOfLinePause>(c, "Pause+OutOfLine");
+  benchmark<retlock::ReTLockBiased>(c, "Biased");
+  benchmark<retlock::ReTLockPaddedFutex>(c, "Futex+Padding");
+  benchmark<retlock::ReTLockSameLineFutex>(c, "Futex+SameLine");
+  benchmark<retlock::ReTLockQueueSpin>(c, "Spin+MCS");
+  benchmark<retlock::ReTLockQueueFutex>(c, "Futex+MCS");
+  benchmark<retlock::ReTLockPaddedOutOfLine>(c, "Yie+Padding+OutOfLine");
+  benchmark<retlock::ReTLockQueuePause>(c, "Pause+MCS");
+  benchmark<retlock::ReTLockSameLineOwnerAware>(c, "Owner+SameLine");
+  benchmark<retlock::ReTLockQueueOwnerAware>(c, "Owner+MCS");
+  benchmark<retlock::ReTLockMalthusian>(c, "Malthus+NoSl+Padding");
+  benchmark<retlock::ReTLockMalthusianQueue>(c, "Malthus+MCS");
 }
 
 auto main(int argc, char** argv) -> int {
   cxxopts::Options options(*argv, "Benchmark for reentrant locking");
 
-  Config c{"benchmark.csv", 0, 0, 0};
+  Config c{"benchmark.csv", 0, 0, 0, false, 0};
 
   // clang-format off
   options.add_options()
@@ -178,6 +249,8 @@ auto main(int argc, char** argv) -> int {
     ("t,thread", "Number of the max thread", cxxopts::value(c.num_threads)->default_value("4"))
     ("r,", "Number of the recursive iteration to lock", cxxopts::value(c.iteration)->default_value("8"))
     ("d,", "Duration of benchmark (seconds)", cxxopts::value(c.duration)->default_value("10"))
+    ("u,uncontended", "Run only the single-thread uncontended scenario")
+    ("o,oversubscribe", "Run only with this many threads per hardware thread", cxxopts::value(c.oversubscription)->default_value("0"))
   ;
   // clang-format on
 
@@ -193,6 +266,26 @@ auto main(int argc, char** argv) -> int {
     return 0;
   }
 
+  // single-thread uncontended case: one lock/unlock pair per iteration
+  if (result["uncontended"].as<bool>()) {
+    c.num_threads = 1;
+    c.iteration = 1;
+    c.back_and_forth = false;
+    work(c);
+    return 0;
+  }
+
+  // oversubscribed case: more threads than the machine can run at once
+  if (0 < c.oversubscription) {
+    const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    c.num_threads = hardware_threads * c.oversubscription;
+    for (bool back_and_forth : {false, true}) {
+      c.back_and_forth = back_and_forth;
+      work(c);
+    }
+    return 0;
+  }
+
   const size_t threads = c.num_threads;
   const size_t iteration = c.iteration;
   for (bool back_and_forth : {false, true}) {
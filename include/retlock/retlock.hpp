@@ -4,7 +4,10 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_thread.hpp>
 #include <thread>
 
 namespace retlock {
@@ -12,70 +15,75 @@ namespace retlock {
   /**
    * @brief An optimized implementation of reentrant locking.
    * Padding: this implementation uses padding to avoid false sharing of lock and counter.
-   * Compatible with std::recurisve_mutex.
+   * Adaptive: the owner publishes a hint in the lock word, the log2 of its recursion depth and
+   * of an EWMA of past hold times of this lock, and waiters spin, pause or sleep depending on how
+   * long the hint says the lock will stay held. The longest waits are capped sleeps, not parking:
+   * unlock() wakes nobody. Only every HOLD_SAMPLE_EVERY-th acquisition is timed, on HoldClock, so
+   * the uncontended path reads no clock.
+   * Compatible with std::recurisve_mutex and std::recursive_timed_mutex.
    * @note
    * Public Methods:
    *   - lock()
    *   - unlock()
    *   - try_lock()
+   *   - try_lock_for(const std::chrono::duration&)
+   *   - try_lock_until(const std::chrono::time_point&)
+   *   - expectedHold()
    */
 
-  enum class SleepType { NoSleep, Adaptive, Yield, Exponential };
+  /**
+   * Pause: PauseBackoff, calibrated CPU pauses that never enter the kernel for short waits. Every
+   * sleep type works with ReTLockImpl and ReTLockSameLineImpl; ReTLockOutOfLineImpl takes all but
+   * Adaptive. BasicReTLock spells Pause as the PauseWait policy.
+   */
+  enum class SleepType { NoSleep, Adaptive, Yield, Exponential, Pause };
 
-  template <SleepType Sleep = SleepType::Exponential> class ReTLockImpl {
+  template <SleepType Sleep = SleepType::Exponential,
+            typename HoldClock = std::chrono::steady_clock>
+  class ReTLockImpl {
   public:
-    ReTLockImpl() : lock_(), counter_(0), counter_max_(0) {}
+    ReTLockImpl() : lock_(), counter_(0), acquisitions_(0), acquired_at_ns_(0), hold_ewma_ns_(0) {}
     ReTLockImpl(const ReTLockImpl&) = delete;
     ReTLockImpl& operator=(const ReTLockImpl&) = delete;
 
     static constexpr uint32_t LOCKED = 1;
     static constexpr uint32_t UNLOCKED = 0;
 
+    /** Layout of the Adaptive hint: log2(depth) << HOLD_BITS | log2(EWMA of hold nanoseconds) */
+    static constexpr uint32_t HOLD_BITS = 6;
+    static constexpr uint32_t MAX_DEPTH_LOG = 31;
+    static constexpr uint32_t HOLD_SAMPLE_EVERY = 64;
+
     void lock() {
       for (size_t i = 0; !try_lock(); ++i) {
-        if constexpr (Sleep == SleepType::NoSleep) {
-          continue;
-        }
-        if constexpr (Sleep == SleepType::Adaptive) {
-          auto current = getLocalLockCache();
-          const size_t adaptive = current.recursive_count_metric;
-          std::this_thread::sleep_for(std::chrono::nanoseconds(1 << (adaptive)));
-        } else if constexpr (Sleep == SleepType::Exponential) {
-          std::this_thread::sleep_for(std::chrono::nanoseconds(1 << (i / 10)));
-        } else if constexpr (Sleep == SleepType::Yield) {
-          std::this_thread::yield();
-        } else {
-          static_assert(Sleep == SleepType::Adaptive || Sleep == SleepType::Exponential
-                            || Sleep == SleepType::Yield || Sleep == SleepType::NoSleep,
-                        "Invalid SleepType");
-        }
-        // NOTE: glibc uses exponential backoff here
+        backoff(i);
       }
     }
 
     bool try_lock() {
       auto current = lock_.load(std::memory_order_relaxed);
-      if constexpr (Sleep == SleepType::Adaptive) {
-        auto& cache = getLocalLockCache();
-        cache = current;
-      }
       if (isAlreadyLocked(current)) {
         assert(0 < counter_);
         counter_++;
         if constexpr (Sleep == SleepType::Adaptive) {
-          counter_max_ = std::max(counter_max_, counter_);
+          // republish only when log2(depth) changes, so nesting rarely writes the lock word
+          if (isPowerOfTwo(counter_)) publishDepth(current);
         }
         return true;
       }
       if (LOCKED == current.lockbits) return false;
       assert(current.owner_tid == 0);
 
-      Container desired{getThreadId(), LOCKED, current.recursive_count_metric};
+      // the released word carries the hold estimate at depth 1 over to the next owner
+      Container desired{getThreadId(), LOCKED, current.hold_hint};
 
       auto success = lock_.compare_exchange_weak(current, desired);
       if (success) {
         assert(counter_ == 0);
         counter_++;
+        if constexpr (Sleep == SleepType::Adaptive) {
+          if (++acquisitions_ % HOLD_SAMPLE_EVERY == 0) acquired_at_ns_ = nowNanos();
+        }
       }
       return success;
     }
@@ -87,10 +95,49 @@ namespace retlock {
       assert(0 < counter_);
       counter_--;
       if (0 < counter_) {
+        if constexpr (Sleep == SleepType::Adaptive) {
+          if (isPowerOfTwo(counter_ + 1)) publishDepth(current);
+        }
         return;
       }
 
-      lock_.store(Container{0, UNLOCKED, 0});
+      uint32_t hint = 0;
+      if constexpr (Sleep == SleepType::Adaptive) {
+        // back at depth 1, so the hint is just the hold estimate
+        hint = current.hold_hint;
+        if (acquired_at_ns_ != 0) {
+          const uint64_t held = nowNanos() - acquired_at_ns_;
+          acquired_at_ns_ = 0;
+          // EWMA with weight 1/8 on the newest sampled hold
+          hold_ewma_ns_ = hold_ewma_ns_ - hold_ewma_ns_ / 8 + held / 8;
+          hint = log2Floor(hold_ewma_ns_);
+        }
+      }
+      lock_.store(Container{0, UNLOCKED, hint});
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+      return try_lock_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <typename Clock, typename Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+      for (size_t i = 0; !try_lock(); ++i) {
+        if (deadline <= Clock::now()) return false;
+        backoff(i);
+      }
+      return true;
+    }
+
+    /**
+     * Adaptive: the log2 of the nanoseconds the current owner is expected to keep the lock, or
+     * 0 while it is free. Always 0 with other sleep types.
+     */
+    uint32_t expectedHold() const {
+      auto current = lock_.load(std::memory_order_relaxed);
+      if (UNLOCKED == current.lockbits) return 0;
+      return expectedHoldLog(current);
     }
 
   private:
@@ -98,11 +145,10 @@ namespace retlock {
     struct Container {
       uint32_t owner_tid : 32;
       uint32_t lockbits : 1;
-      uint32_t recursive_count_metric : 31;
+      uint32_t hold_hint : 31;
 
-      Container() : owner_tid(0), lockbits(0), recursive_count_metric(0) {}
-      Container(uint32_t o, uint32_t c, uint32_t r)
-          : owner_tid(o), lockbits(c), recursive_count_metric(r) {}
+      Container() : owner_tid(0), lockbits(0), hold_hint(0) {}
+      Container(uint32_t o, uint32_t c, uint32_t h) : owner_tid(o), lockbits(c), hold_hint(h) {}
     };
     static_assert(sizeof(Container) == sizeof(uint64_t));
     static_assert(std::atomic<Container>::is_always_lock_free, "This class is not lock-free");
@@ -110,18 +156,76 @@ namespace retlock {
     /** Members */
     alignas(64) std::atomic<Container> lock_;
     alignas(64) size_t counter_;
-    size_t counter_max_;
+    // Adaptive: owner-only hold statistics, guarded by the lock
+    uint32_t acquisitions_;
+    // 0 unless this acquisition is timed
+    uint64_t acquired_at_ns_;
+    uint64_t hold_ewma_ns_;
+
+    /** Adaptive: holds expected to end within 2^SPIN_LOG ns are spun on, past 2^SLEEP_LOG slept */
+    static constexpr size_t SPIN_LOG = 10;
+    static constexpr size_t SLEEP_LOG = 16;
+    // every SPINS_PER_STEP failed retries double the estimate, in case the owner was preempted
+    static constexpr size_t SPINS_PER_STEP = 64;
+
+    inline static uint64_t nowNanos() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 HoldClock::now().time_since_epoch())
+          .count();
+    }
+
+    inline static bool isPowerOfTwo(size_t n) { return (n & (n - 1)) == 0; }
 
-    static std::atomic<uint32_t> thread_id_allocator_;
+    inline static uint32_t log2Floor(uint64_t n) {
+      uint32_t log = 0;
+      for (; 1 < n; n >>= 1) {
+        log++;
+      }
+      return log;
+    }
 
-    inline static uint32_t getThreadId() {
-      static thread_local uint32_t thread_id = thread_id_allocator_.fetch_add(1);
-      return thread_id;
+    /** A deeper owner is assumed to be further from its final unlock */
+    inline static uint32_t expectedHoldLog(Container current) {
+      return (current.hold_hint >> HOLD_BITS) + (current.hold_hint & ((1u << HOLD_BITS) - 1));
     }
 
-    inline static Container& getLocalLockCache() {
-      static thread_local Container cache{};
-      return cache;
+    /** Owner only: replaces the depth part of the hint with log2(counter_) */
+    inline void publishDepth(Container current) {
+      const uint32_t depth_log = std::min<uint32_t>(log2Floor(counter_), MAX_DEPTH_LOG);
+      const uint32_t hold_log = current.hold_hint & ((1u << HOLD_BITS) - 1);
+      lock_.store(Container{current.owner_tid, LOCKED, (depth_log << HOLD_BITS) | hold_log},
+                  std::memory_order_relaxed);
+    }
+
+    inline void backoff(size_t i) const {
+      if constexpr (Sleep == SleepType::NoSleep) {
+        return;
+      }
+      if constexpr (Sleep == SleepType::Adaptive) {
+        auto current = lock_.load(std::memory_order_relaxed);
+        if (UNLOCKED == current.lockbits) return;  // just released: retry at once
+        const size_t expected = expectedHoldLog(current) + i / SPINS_PER_STEP;
+        if (expected < SPIN_LOG) {
+          detail::cpuRelax();
+        } else if (expected < SLEEP_LOG) {
+          PauseBackoff<>::pause(i % SPINS_PER_STEP);
+        } else {
+          // sleep through half of the expected hold
+          detail::sleepExponential(expected - 1);
+        }
+      } else if constexpr (Sleep == SleepType::Exponential) {
+        detail::sleepExponential(i / 10);
+      } else if constexpr (Sleep == SleepType::Yield) {
+        std::this_thread::yield();
+      } else if constexpr (Sleep == SleepType::Pause) {
+        PauseBackoff<>::pause(i);
+      } else {
+        static_assert(Sleep == SleepType::Adaptive || Sleep == SleepType::Exponential
+                          || Sleep == SleepType::Yield || Sleep == SleepType::NoSleep
+                          || Sleep == SleepType::Pause,
+                      "Invalid SleepType");
+      }
+      // NOTE: glibc uses exponential backoff here
     }
 
     template <typename T> inline bool isAlreadyLocked(T& current) const {
@@ -133,11 +237,7 @@ namespace retlock {
   using ReTLockYieldPadding = ReTLockImpl<SleepType::Yield>;
   using ReTLockAdaptivePadding = ReTLockImpl<SleepType::Adaptive>;
   using ReTLockNoSleepPadding = ReTLockImpl<SleepType::NoSleep>;
+  using ReTLockPausePadding = ReTLockImpl<SleepType::Pause>;
 
   using ReTLock = ReTLockAdaptivePadding;
-
-  template <> std::atomic<uint32_t> ReTLockPadding::thread_id_allocator_(1);
-  template <> std::atomic<uint32_t> ReTLockYieldPadding::thread_id_allocator_(1);
-  template <> std::atomic<uint32_t> ReTLockAdaptivePadding::thread_id_allocator_(1);
-  template <> std::atomic<uint32_t> ReTLockNoSleepPadding::thread_id_allocator_(1);
 }  // namespace retlock
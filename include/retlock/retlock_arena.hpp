@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <retlock/retlock_numa.hpp>
+#include <utility>
+#include <vector>
+
+namespace retlock {
+
+  /**
+   * @brief An arena of cache-line-aligned slots for locks of one type, carved from per-node slabs.
+   * create() constructs a lock in a free slot of the calling thread's NUMA node, allocating a slab
+   * of SlabSlots slots there when the node runs out; destroy() returns the slot to the free list
+   * of the node it came from. Slabs are zeroed by the thread that allocates them, so first-touch
+   * page placement puts them on that thread's node. Every slot spans whole cache lines, so
+   * neighbouring locks never share one. clear() destroys all live locks at once and keeps the
+   * slabs for reuse; the arena frees its slabs when it is destroyed.
+   * @note
+   * Public Methods:
+   *   - create(Args&&...)
+   *   - destroy(Lock*)
+   *   - clear()
+   *   - size()
+   *   - nodeOf(const Lock*)
+   */
+
+  template <typename Lock, size_t SlabSlots = 64> class LockArena {
+    static_assert(0 < SlabSlots, "A slab needs at least one slot");
+
+  public:
+    explicit LockArena(const NumaTopology& topology = NumaTopology::instance())
+        : topology_(topology), nodes_(topology.numNodes()) {}
+    ~LockArena() { clear(); }
+    LockArena(const LockArena&) = delete;
+    LockArena& operator=(const LockArena&) = delete;
+
+    /** A lock constructed from `args` in a slot of the calling thread's node */
+    template <typename... Args> Lock* create(Args&&... args) {
+      const auto node = topology_.currentNode() % nodes_.size();
+      auto& arena = nodes_[node];
+      Slot* slot = nullptr;
+      {
+        std::lock_guard<std::mutex> guard(arena.mutex_);
+        if (arena.free_ == nullptr) {
+          grow(arena, static_cast<uint32_t>(node));
+        }
+        slot = arena.free_;
+        arena.free_ = slot->next_free_;
+        arena.live_++;
+      }
+      auto* lock = new (slot->storage_) Lock(std::forward<Args>(args)...);
+      slot->live_ = true;
+      return lock;
+    }
+
+    /** Destroys a lock made by create() and frees its slot */
+    void destroy(Lock* lock) {
+      auto* slot = slotOf(lock);
+      assert(slot->live_);
+      lock->~Lock();
+      slot->live_ = false;
+      auto& arena = nodes_[slot->node_];
+      std::lock_guard<std::mutex> guard(arena.mutex_);
+      slot->next_free_ = arena.free_;
+      arena.free_ = slot;
+      arena.live_--;
+    }
+
+    /** Destroys every live lock; no other thread may use the arena meanwhile */
+    void clear() {
+      for (auto& arena : nodes_) {
+        std::lock_guard<std::mutex> guard(arena.mutex_);
+        arena.free_ = nullptr;
+        for (auto& slab : arena.slabs_) {
+          for (size_t i = SlabSlots; 0 < i; --i) {
+            auto& slot = slab[i - 1];
+            if (slot.live_) {
+              std::launder(reinterpret_cast<Lock*>(slot.storage_))->~Lock();
+              slot.live_ = false;
+            }
+            slot.next_free_ = arena.free_;
+            arena.free_ = &slot;
+          }
+        }
+        arena.live_ = 0;
+      }
+    }
+
+    /** The number of live locks */
+    size_t size() const {
+      size_t live = 0;
+      for (auto& arena : nodes_) {
+        std::lock_guard<std::mutex> guard(arena.mutex_);
+        live += arena.live_;
+      }
+      return live;
+    }
+
+    /** The node whose slab holds `lock` */
+    uint32_t nodeOf(const Lock* lock) const { return slotOf(lock)->node_; }
+
+  private:
+    /** Inner classes */
+    static constexpr std::size_t cache_line_size() { return 64; }
+
+    struct alignas(std::max(alignof(Lock), cache_line_size())) Slot {
+      // first member, so a Lock* converts back to its Slot*
+      alignas(Lock) unsigned char storage_[sizeof(Lock)];
+      Slot* next_free_;
+      uint32_t node_;
+      bool live_;
+    };
+    static_assert(sizeof(Slot) % cache_line_size() == 0);
+
+    struct NodeArena {
+      mutable std::mutex mutex_;
+      std::vector<std::unique_ptr<Slot[]>> slabs_;
+      Slot* free_ = nullptr;
+      size_t live_ = 0;
+    };
+
+    /** Members */
+    const NumaTopology topology_;
+    std::vector<NodeArena> nodes_;
+
+    inline static Slot* slotOf(const Lock* lock) {
+      return reinterpret_cast<Slot*>(
+          const_cast<unsigned char*>(reinterpret_cast<const unsigned char*>(lock)));
+    }
+
+    /** Adds a slab to `arena`; the caller holds its mutex */
+    static void grow(NodeArena& arena, uint32_t node) {
+      // value-initialized, i.e. written by this thread before anyone else touches it
+      std::unique_ptr<Slot[]> slab(new Slot[SlabSlots]());
+      for (size_t i = SlabSlots; 0 < i; --i) {
+        auto& slot = slab[i - 1];
+        slot.node_ = node;
+        slot.next_free_ = arena.free_;
+        arena.free_ = &slot;
+      }
+      arena.slabs_.push_back(std::move(slab));
+    }
+  };
+}  // namespace retlock
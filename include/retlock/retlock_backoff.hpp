@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace retlock {
+
+  namespace detail {
+    /** One CPU pause/yield instruction, or a compiler barrier where there is none */
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+      asm volatile("yield");
+#else
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+    /**
+     * Nanoseconds one cpuRelax() takes on this machine, measured on first use.
+     * The pause latency varies by an order of magnitude across CPU generations (about 10 cycles
+     * before Skylake, about 140 after), so fixed pause counts do not give fixed delays.
+     */
+    inline double nanosPerPause() {
+      static const double nanos = [] {
+        constexpr int ROUNDS = 5;
+        constexpr int PAUSES = 2000;
+        // the fastest round is the one least disturbed by preemption
+        double best = 1e9;
+        for (int round = 0; round < ROUNDS; ++round) {
+          const auto start = std::chrono::steady_clock::now();
+          for (int i = 0; i < PAUSES; ++i) {
+            cpuRelax();
+          }
+          const std::chrono::duration<double, std::nano> elapsed
+              = std::chrono::steady_clock::now() - start;
+          best = std::min(best, elapsed.count() / PAUSES);
+        }
+        return std::max(best, 0.1);
+      }();
+      return nanos;
+    }
+
+    /** The longest exponential sleep is 2^MAX_SLEEP_SHIFT ns, about a millisecond */
+    constexpr size_t MAX_SLEEP_SHIFT = 20;
+
+    /** Sleeps for 2^shift nanoseconds, capped at 2^MAX_SLEEP_SHIFT */
+    inline void sleepExponential(size_t shift) {
+      std::this_thread::sleep_for(
+          std::chrono::nanoseconds(uint64_t(1) << std::min(shift, MAX_SLEEP_SHIFT)));
+    }
+
+    /** A per-thread xorshift generator; good enough to de-synchronize waiters */
+    inline uint32_t nextRandom() {
+      static thread_local uint32_t state = [] {
+        static std::atomic<uint32_t> seed(0x9E3779B9u);
+        auto s = seed.fetch_add(0x6D2B79F5u, std::memory_order_relaxed);
+        return s != 0 ? s : 1u;
+      }();
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return state;
+    }
+  }  // namespace detail
+
+  /**
+   * @brief Randomized, capped exponential backoff made of calibrated CPU pauses.
+   * The i-th wait lasts a random time in [w/2, w] with w = min(BaseNs << i, CapNs), spent in
+   * pause instructions whose cost was calibrated once, so short waits never enter the kernel.
+   * Once the window reaches the cap, each wait also yields the CPU, so a preempted holder can
+   * run on an oversubscribed machine.
+   * @note
+   * Public Methods:
+   *   - pause(size_t)
+   */
+
+  template <uint32_t BaseNs = 32, uint32_t CapNs = 32768> class PauseBackoff {
+    static_assert(0 < BaseNs && BaseNs <= CapNs, "Invalid backoff window");
+
+  public:
+    static constexpr size_t MAX_SHIFT = 31;
+
+    static void pause(size_t i) {
+      const uint64_t window
+          = std::min<uint64_t>(uint64_t(BaseNs) << std::min(i, MAX_SHIFT), CapNs);
+      // waiters that failed together should not retry together
+      const uint64_t nanos = window / 2 + detail::nextRandom() % (window / 2 + 1);
+      const auto pauses = static_cast<uint64_t>(nanos / detail::nanosPerPause()) + 1;
+      for (uint64_t p = 0; p < pauses; ++p) {
+        detail::cpuRelax();
+      }
+      if (window == CapNs) {
+        std::this_thread::yield();
+      }
+    }
+  };
+}  // namespace retlock
@@ -0,0 +1,504 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_futex.hpp>
+#include <retlock/retlock_held.hpp>
+#include <retlock/retlock_node_pool.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+namespace retlock {
+
+  /**
+   * Policies of BasicReTLock.
+   *
+   * Order: memory orderings of the acquiring and releasing atomics.
+   *   static constexpr std::memory_order ACQUIRE, RELEASE, ACQ_REL;
+   *
+   * Wait: how a thread waits for a 32-bit word to change, and how the releaser wakes it.
+   * `owner` is the id of the thread holding the lock, or 0 if unknown; a wait that blocks
+   * returns within `timeout`, unless that is nullptr.
+   *   void pause(std::atomic<uint32_t>& word, uint32_t observed, uint32_t owner, size_t i,
+   *              const struct timespec* timeout);
+   *   void notify(std::atomic<uint32_t>& word);
+   *
+   * Counter: where the recursion depth lives.
+   *   template <typename IsOwner> bool reenter(IsOwner is_owner);  // nested acquisition
+   *   void acquired();                                             // first acquisition
+   *   bool release();                                              // true when the last level
+   *   void forget();                                               // destroyed by its holder
+   *
+   * Layout: how the lock word, the waiting state and the counter are laid out and acquired.
+   *   template <typename Counter, typename Wait, typename Order> class Storage {
+   *     bool tryAcquire(uint32_t tid); void acquire(uint32_t tid); void release();
+   *     template <typename Clock, typename Duration>
+   *     bool acquireUntil(uint32_t tid, const std::chrono::time_point<Clock, Duration>&);
+   *     uint32_t owner() const; Counter& counter(); void forget();
+   *   };
+   */
+
+  namespace detail {
+    /** The deadline of an untimed acquisition */
+    constexpr const std::chrono::steady_clock::time_point* NO_DEADLINE = nullptr;
+
+    /** An owner-id word, 0 when free, acquired with a CAS; a stateless Wait takes no space */
+    template <typename Wait, typename Order> class OwnerWord : private Wait {
+    public:
+      OwnerWord() : owner_(0) {}
+
+      bool tryAcquire(uint32_t tid) {
+        auto current = owner_.load(std::memory_order_relaxed);
+        return current == 0
+               && owner_.compare_exchange_strong(current, tid, Order::ACQUIRE,
+                                                 std::memory_order_relaxed);
+      }
+
+      /** Fails only once the deadline, if any, has passed */
+      template <typename Clock, typename Duration>
+      bool acquire(uint32_t tid, const std::chrono::time_point<Clock, Duration>* deadline) {
+        for (size_t i = 0;; ++i) {
+          auto current = owner_.load(std::memory_order_relaxed);
+          if (current == 0
+              && owner_.compare_exchange_strong(current, tid, Order::ACQUIRE,
+                                                std::memory_order_relaxed)) {
+            return true;
+          }
+          // a failed CAS leaves the new owner in current, so we never wait on a free word
+          if (deadline == nullptr) {
+            Wait::pause(owner_, current, current, i, nullptr);
+            continue;
+          }
+          struct timespec timeout;
+          if (!timeLeft(*deadline, timeout)) return false;
+          Wait::pause(owner_, current, current, i, &timeout);
+        }
+      }
+
+      void release() {
+        owner_.store(0, Order::RELEASE);
+        Wait::notify(owner_);
+      }
+
+      uint32_t owner() const { return owner_.load(std::memory_order_relaxed); }
+
+    private:
+      std::atomic<uint32_t> owner_;
+    };
+  }  // namespace detail
+
+  /** Order policies */
+  struct AcqRelOrder {
+    static constexpr std::memory_order ACQUIRE = std::memory_order_acquire;
+    static constexpr std::memory_order RELEASE = std::memory_order_release;
+    static constexpr std::memory_order ACQ_REL = std::memory_order_acq_rel;
+  };
+
+  /** The orderings of the std::atomic defaults, as ReTLockImpl uses */
+  struct SeqCstOrder {
+    static constexpr std::memory_order ACQUIRE = std::memory_order_seq_cst;
+    static constexpr std::memory_order RELEASE = std::memory_order_seq_cst;
+    static constexpr std::memory_order ACQ_REL = std::memory_order_seq_cst;
+  };
+
+  /** Wait policies */
+  struct SpinWait {
+    void pause(std::atomic<uint32_t>&, uint32_t, uint32_t, size_t, const struct timespec*) {
+      detail::cpuRelax();
+    }
+    void notify(std::atomic<uint32_t>&) {}
+  };
+
+  struct YieldWait {
+    void pause(std::atomic<uint32_t>&, uint32_t, uint32_t, size_t, const struct timespec*) {
+      std::this_thread::yield();
+    }
+    void notify(std::atomic<uint32_t>&) {}
+  };
+
+  struct ExponentialWait {
+    void pause(std::atomic<uint32_t>&, uint32_t, uint32_t, size_t i, const struct timespec*) {
+      detail::sleepExponential(i / 10);
+    }
+    void notify(std::atomic<uint32_t>&) {}
+  };
+
+  /** PauseBackoff: calibrated, randomized and capped CPU pauses */
+  template <uint32_t BaseNs = 32, uint32_t CapNs = 32768> struct PauseWait {
+    void pause(std::atomic<uint32_t>&, uint32_t, uint32_t, size_t i, const struct timespec*) {
+      PauseBackoff<BaseNs, CapNs>::pause(i);
+    }
+    void notify(std::atomic<uint32_t>&) {}
+  };
+
+  /** Spins, then sleeps in the kernel on the word; the releaser only wakes when someone sleeps */
+  template <uint32_t SpinCount = 128> struct FutexWait {
+    std::atomic<uint32_t> sleepers_{0};
+
+    void pause(std::atomic<uint32_t>& word, uint32_t observed, uint32_t, size_t i,
+               const struct timespec* timeout) {
+      if (i < SpinCount) {
+        detail::cpuRelax();
+        return;
+      }
+      sleepers_.fetch_add(1);
+      detail::futexWait(&word, observed, timeout);
+      sleepers_.fetch_sub(1);
+    }
+
+    void notify(std::atomic<uint32_t>& word) {
+      // pairs with fetch_add() in pause(): either I see the sleeper, or it sees the new word
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (0 < sleepers_.load(std::memory_order_relaxed)) {
+        detail::futexWake(&word, 1);
+      }
+    }
+  };
+
+  /**
+   * Adaptive mutex semantics, as in Solaris: spins only while the owner is running, and parks
+   * like FutexWait once the owner blocks (see BlockingRegion) or after SpinCount spins, which
+   * bounds the time lost behind an owner that was preempted.
+   */
+  template <uint32_t SpinCount = 1024> struct OwnerAwareWait : FutexWait<SpinCount> {
+    void pause(std::atomic<uint32_t>& word, uint32_t observed, uint32_t owner, size_t i,
+               const struct timespec* timeout) {
+      if (ThreadRegistry::isRunning(owner)) {
+        FutexWait<SpinCount>::pause(word, observed, owner, i, timeout);
+      } else {
+        FutexWait<SpinCount>::pause(word, observed, owner, SpinCount, timeout);
+      }
+    }
+  };
+
+  /** Counter policies */
+  /** The depth next to the lock word, only touched by the owner */
+  class InlineCounter {
+  public:
+    template <typename IsOwner> bool reenter(IsOwner is_owner) {
+      if (!is_owner()) return false;
+      assert(0 < depth_);
+      depth_++;
+      return true;
+    }
+
+    void acquired() {
+      assert(depth_ == 0);
+      depth_ = 1;
+    }
+
+    bool release() {
+      assert(0 < depth_);
+      return --depth_ == 0;
+    }
+
+    void forget() { depth_ = 0; }
+
+  private:
+    uint32_t depth_ = 0;
+  };
+
+  /** The depth in the holder's HeldLockTable; nested acquisitions skip the lock word */
+  class OutOfLineCounter {
+  public:
+    template <typename IsOwner> bool reenter(IsOwner) {
+      auto* depth = HeldLockTable::local().find(this);
+      if (depth == nullptr) return false;
+      assert(0 < *depth);
+      (*depth)++;
+      return true;
+    }
+
+    void acquired() { HeldLockTable::local().insert(this); }
+
+    bool release() {
+      auto& held = HeldLockTable::local();
+      auto* depth = held.find(this);
+      assert(depth != nullptr && 0 < *depth);
+      if (0 < --*depth) return false;
+      held.erase(this);
+      return true;
+    }
+
+    void forget() {
+      auto& held = HeldLockTable::local();
+      if (held.find(this) != nullptr) {
+        held.erase(this);
+      }
+    }
+  };
+
+  /** Layout policies */
+  /** The lock word and the counter on separate cache lines, as in ReTLockImpl */
+  struct PaddedLayout {
+    template <typename Counter, typename Wait, typename Order> class Storage {
+    public:
+      bool tryAcquire(uint32_t tid) { return word_.tryAcquire(tid); }
+      void acquire(uint32_t tid) { word_.acquire(tid, detail::NO_DEADLINE); }
+      template <typename Clock, typename Duration>
+      bool acquireUntil(uint32_t tid, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return word_.acquire(tid, &deadline);
+      }
+      void release() { word_.release(); }
+      uint32_t owner() const { return word_.owner(); }
+      Counter& counter() { return counter_; }
+      void forget() {}
+
+    private:
+      alignas(64) detail::OwnerWord<Wait, Order> word_;
+      alignas(64) Counter counter_;
+    };
+  };
+
+  /** The lock word and the counter side by side; ReTLockSameLineImpl packs both in one word */
+  struct SameLineLayout {
+    template <typename Counter, typename Wait, typename Order> class Storage {
+    public:
+      bool tryAcquire(uint32_t tid) { return word_.tryAcquire(tid); }
+      void acquire(uint32_t tid) { word_.acquire(tid, detail::NO_DEADLINE); }
+      template <typename Clock, typename Duration>
+      bool acquireUntil(uint32_t tid, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return word_.acquire(tid, &deadline);
+      }
+      void release() { word_.release(); }
+      uint32_t owner() const { return word_.owner(); }
+      Counter& counter() { return counter_; }
+      void forget() {}
+
+    private:
+      detail::OwnerWord<Wait, Order> word_;
+      Counter counter_;
+    };
+  };
+
+  /**
+   * An MCS queue of per-thread nodes in front of the owner id. A timed waiter that gives up marks
+   * its node abandoned and leaves it in the queue; the releaser that reaches it passes the lock on
+   * and retires the node.
+   */
+  struct QueueLayout {
+    template <typename Counter, typename Wait, typename Order> class Storage {
+    public:
+      Storage() : tail_(nullptr), owner_(0) {}
+
+      bool tryAcquire(uint32_t tid) {
+        auto& pool = NodePool<QNode>::local();
+        auto* my_node = enqueueable(pool.acquire(this));
+        QNode* expected = nullptr;
+        if (!tail_.compare_exchange_strong(expected, my_node, Order::ACQUIRE,
+                                           std::memory_order_relaxed)) {
+          pool.release(this, my_node);
+          return false;
+        }
+        owner_.store(tid, std::memory_order_relaxed);
+        return true;
+      }
+
+      void acquire(uint32_t tid) { enqueue(tid, detail::NO_DEADLINE); }
+
+      template <typename Clock, typename Duration>
+      bool acquireUntil(uint32_t tid, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return enqueue(tid, &deadline);
+      }
+
+      void release() {
+        owner_.store(0, std::memory_order_relaxed);
+        auto& pool = NodePool<QNode>::local();
+        auto* my_node = pool.find(this);
+        assert(my_node != nullptr);
+        // successors that abandoned their node refuse the lock; pass it on for them
+        for (auto* node = my_node; node != nullptr;) {
+          auto* abandoned = passOn(node);
+          if (node != my_node) {
+            // NOTE: not deleted, a late notify() may still touch it
+            NodePool<QNode>::retire(node);
+          }
+          node = abandoned;
+        }
+        pool.release(this, my_node);
+      }
+
+      uint32_t owner() const { return owner_.load(std::memory_order_relaxed); }
+      Counter& counter() { return counter_; }
+
+      void forget() {
+        auto& pool = NodePool<QNode>::local();
+        if (auto* my_node = pool.find(this)) {
+          pool.release(this, my_node);
+        }
+      }
+
+    private:
+      /** QNode::waiting_ */
+      static constexpr uint32_t GRANTED = 0;
+      static constexpr uint32_t WAITING = 1;
+      static constexpr uint32_t ABANDONED = 2;
+
+      struct alignas(64) QNode {
+        std::atomic<QNode*> next_;
+        std::atomic<uint32_t> waiting_;
+        QNode() : next_(nullptr), waiting_(GRANTED) {}
+      };
+
+      std::atomic<QNode*> tail_;
+      std::atomic<uint32_t> owner_;
+      Wait wait_;
+      Counter counter_;
+
+      inline static QNode* enqueueable(QNode* node) {
+        node->next_.store(nullptr, std::memory_order_relaxed);
+        node->waiting_.store(WAITING, std::memory_order_relaxed);
+        return node;
+      }
+
+      /** Fails only once the deadline, if any, has passed; my node then stays in the queue */
+      template <typename Clock, typename Duration>
+      bool enqueue(uint32_t tid, const std::chrono::time_point<Clock, Duration>* deadline) {
+        auto& pool = NodePool<QNode>::local();
+        auto* my_node = enqueueable(pool.acquire(this));
+        auto* pred = tail_.exchange(my_node, Order::ACQ_REL);
+        if (pred != nullptr) {
+          pred->next_.store(my_node, std::memory_order_release);
+          for (size_t i = 0;; ++i) {
+            auto waiting = my_node->waiting_.load(Order::ACQUIRE);
+            if (waiting == GRANTED) break;
+            const auto owner = owner_.load(std::memory_order_relaxed);
+            if (deadline == nullptr) {
+              wait_.pause(my_node->waiting_, waiting, owner, i, nullptr);
+              continue;
+            }
+            struct timespec timeout;
+            if (detail::timeLeft(*deadline, timeout)) {
+              wait_.pause(my_node->waiting_, waiting, owner, i, &timeout);
+              continue;
+            }
+            // fails only if the lock was granted meanwhile
+            if (my_node->waiting_.compare_exchange_strong(waiting, ABANDONED, Order::ACQ_REL)) {
+              pool.abandon(this);
+              return false;
+            }
+            break;
+          }
+        }
+        owner_.store(tid, std::memory_order_relaxed);
+        return true;
+      }
+
+      /** Hands the lock to the successor of `node`; returns the successor if it abandoned */
+      QNode* passOn(QNode* node) {
+        auto* next = node->next_.load(std::memory_order_acquire);
+        if (next == nullptr) {
+          auto expected = node;
+          if (tail_.compare_exchange_strong(expected, nullptr, Order::RELEASE,
+                                            std::memory_order_relaxed)) {
+            return nullptr;
+          }
+          while ((next = node->next_.load(std::memory_order_acquire)) == nullptr) {
+            detail::cpuRelax();
+          }
+        }
+        auto waiting = WAITING;
+        if (!next->waiting_.compare_exchange_strong(waiting, GRANTED, Order::ACQ_REL)) {
+          return next;
+        }
+        // NOTE: the successor may be done with its node by now; nodes are never freed, so this
+        // is at worst a spurious wake-up
+        wait_.notify(next->waiting_);
+        return nullptr;
+      }
+    };
+  };
+
+  /**
+   * @brief A reentrant lock assembled from independent compile-time policies.
+   * Layout decides where the lock word and the counter live and how the word is acquired
+   * (PaddedLayout, SameLineLayout, QueueLayout); Wait how waiters pass the time (SpinWait,
+   * YieldWait, ExponentialWait, PauseWait, FutexWait, OwnerAwareWait); Counter where the
+   * recursion depth is kept (InlineCounter, OutOfLineCounter); Order which memory orderings are
+   * used (AcqRelOrder, SeqCstOrder). See the policy interfaces above to plug in your own.
+   * Only the combinations at the end of this file are instances of it. The other locks of this
+   * library are written by hand, ReTLockImpl, ReTLockSameLineImpl and ReTLockQueueImpl among them
+   * so that their benchmark numbers keep measuring the same code; ReTLockOutOfLineImpl behaves
+   * like BasicReTLock<PaddedLayout, ..., OutOfLineCounter>.
+   * Compatible with std::recurisve_mutex and std::recursive_timed_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   *   - try_lock_for(const std::chrono::duration&)
+   *   - try_lock_until(const std::chrono::time_point&)
+   */
+
+  template <typename Layout, typename Wait, typename Counter = InlineCounter,
+            typename Order = AcqRelOrder>
+  class BasicReTLock {
+  public:
+    BasicReTLock() = default;
+    ~BasicReTLock() {
+      // destroyed by its holder: leave no trace that a later lock at this address could match
+      if (storage_.owner() == getThreadId()) {
+        storage_.counter().forget();
+        storage_.forget();
+      }
+    }
+    BasicReTLock(const BasicReTLock&) = delete;
+    BasicReTLock& operator=(const BasicReTLock&) = delete;
+
+    void lock() {
+      if (reenter()) return;
+      storage_.acquire(getThreadId());
+      storage_.counter().acquired();
+    }
+
+    bool try_lock() {
+      if (reenter()) return true;
+      if (!storage_.tryAcquire(getThreadId())) return false;
+      storage_.counter().acquired();
+      return true;
+    }
+
+    void unlock() {
+      assert(storage_.owner() == getThreadId());
+      if (!storage_.counter().release()) return;
+      storage_.release();
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+      return try_lock_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <typename Clock, typename Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+      if (reenter()) return true;
+      if (!storage_.acquireUntil(getThreadId(), deadline)) return false;
+      storage_.counter().acquired();
+      return true;
+    }
+
+  private:
+    /** Members */
+    typename Layout::template Storage<Counter, Wait, Order> storage_;
+
+    inline bool reenter() {
+      return storage_.counter().reenter([this] { return storage_.owner() == getThreadId(); });
+    }
+  };
+
+  /** Combinations with no name of their own elsewhere */
+  using ReTLockPaddedFutex = BasicReTLock<PaddedLayout, FutexWait<>>;
+  using ReTLockSameLineFutex = BasicReTLock<SameLineLayout, FutexWait<>>;
+  using ReTLockQueueSpin = BasicReTLock<QueueLayout, SpinWait>;
+  using ReTLockQueueFutex = BasicReTLock<QueueLayout, FutexWait<>>;
+  using ReTLockPaddedOutOfLine = BasicReTLock<PaddedLayout, YieldWait, OutOfLineCounter>;
+  using ReTLockQueuePause = BasicReTLock<QueueLayout, PauseWait<>>;
+  using ReTLockSameLineOwnerAware = BasicReTLock<SameLineLayout, OwnerAwareWait<>>;
+  using ReTLockQueueOwnerAware = BasicReTLock<QueueLayout, OwnerAwareWait<>>;
+}  // namespace retlock
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <retlock/retlock.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+#if defined(__linux__)
+#  include <linux/membarrier.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace retlock {
+
+  namespace detail {
+    /**
+     * Asymmetric fence pair: lightFence() on the frequent side, heavyFence() on the rare side.
+     * With membarrier(2), the heavy side forces a full barrier on every running thread of the
+     * process, so the light side only has to stop the compiler from reordering.
+     */
+    inline bool hasExpeditedMembarrier() {
+#if defined(__linux__) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+      static const bool registered
+          = syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+      return registered;
+#else
+      return false;
+#endif
+    }
+
+    inline void lightFence() {
+      if (hasExpeditedMembarrier()) {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+      } else {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+    }
+
+    inline void heavyFence() {
+#if defined(__linux__) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+      if (hasExpeditedMembarrier()) {
+        syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+        return;
+      }
+#endif
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }  // namespace detail
+
+  /**
+   * @brief A biased (reserved) reentrant lock for thread-affine objects.
+   * The first thread to acquire the lock reserves it. While reserved, that thread's lock() and
+   * unlock() only store its recursion depth; there is no atomic read-modify-write. Another thread
+   * revokes the reservation with a safe-point handshake (an asymmetric fence, then waiting for the
+   * owner to leave its critical section), after which the lock behaves like Fallback forever.
+   * BiasWord is the type of the reservation word; tests substitute one that counts its writes.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   */
+
+  template <typename Fallback = ReTLockPadding, typename BiasWord = std::atomic<uint32_t>>
+  class ReTLockBiasedImpl {
+  public:
+    ReTLockBiasedImpl() : bias_(ANONYMOUS), bias_depth_(0), fallback_() {}
+    ReTLockBiasedImpl(const ReTLockBiasedImpl&) = delete;
+    ReTLockBiasedImpl& operator=(const ReTLockBiasedImpl&) = delete;
+
+    void lock() {
+      const auto tid = getThreadId();
+      for (;;) {
+        auto bias = bias_.load(std::memory_order_acquire);
+        if (bias == REVOKED) {
+          fallback_.lock();
+          return;
+        }
+        if (tryLockBiased(tid, bias)) return;
+        // lost the race to reserve the lock; look again
+        if (bias == ANONYMOUS) continue;
+        if (bias & REVOKING) {
+          // wait for the revocation in progress to settle
+          std::this_thread::yield();
+          continue;
+        }
+        if (ownerOf(bias) != tid) {
+          revoke(bias, false);
+        }
+      }
+    }
+
+    bool try_lock() {
+      const auto tid = getThreadId();
+      for (;;) {
+        auto bias = bias_.load(std::memory_order_acquire);
+        if (bias == REVOKED) return fallback_.try_lock();
+        if (tryLockBiased(tid, bias)) return true;
+        if (bias == ANONYMOUS) continue;
+        if (bias & REVOKING) return false;
+        if (ownerOf(bias) != tid && !revoke(bias, true)) return false;
+      }
+    }
+
+    void unlock() {
+      if (ownerOf(bias_.load(std::memory_order_relaxed)) == getThreadId()) {
+        auto depth = bias_depth_.load(std::memory_order_relaxed);
+        if (0 < depth) {
+          bias_depth_.store(depth - 1, std::memory_order_release);
+          return;
+        }
+      }
+      fallback_.unlock();
+    }
+
+  private:
+    /** bias_: the owner's tid, with REVOKING set while a revocation is in progress */
+    static constexpr uint32_t ANONYMOUS = 0;
+    static constexpr uint32_t REVOKING = uint32_t(1) << 31;
+    static constexpr uint32_t REVOKED = REVOKING;
+
+    /** Members */
+    alignas(64) BiasWord bias_;
+    // written by the bias owner only
+    std::atomic<uint32_t> bias_depth_;
+    Fallback fallback_;
+
+    inline static uint32_t ownerOf(uint32_t bias) { return bias & ~REVOKING; }
+
+    /** The owner's path: no read-modify-write once the lock is reserved */
+    bool tryLockBiased(uint32_t tid, uint32_t bias) {
+      if (bias == ANONYMOUS) {
+        // reserve the lock on its first acquisition
+        if (!bias_.compare_exchange_strong(bias, tid)) return false;
+      }
+      if (ownerOf(bias) != tid) return false;
+
+      auto depth = bias_depth_.load(std::memory_order_relaxed);
+      if (0 < depth) {
+        // nested: a revoker waits for the depth to drop to zero, so just go on
+        bias_depth_.store(depth + 1, std::memory_order_relaxed);
+        return true;
+      }
+      if (bias & REVOKING) return false;
+
+      bias_depth_.store(1, std::memory_order_relaxed);
+      // pairs with the heavy fence in revoke()
+      detail::lightFence();
+      if (bias_.load(std::memory_order_relaxed) == tid) {
+        return true;
+      }
+      // a revocation has started; back out
+      bias_depth_.store(0, std::memory_order_release);
+      return false;
+    }
+
+    /** The safe-point handshake. Returns false if no_wait and the owner is in the lock */
+    bool revoke(uint32_t bias, bool no_wait) {
+      assert(bias != ANONYMOUS && !(bias & REVOKING));
+      if (!bias_.compare_exchange_strong(bias, bias | REVOKING)) return false;
+      detail::heavyFence();
+      while (bias_depth_.load(std::memory_order_acquire) != 0) {
+        if (no_wait) {
+          bias_.store(bias, std::memory_order_release);
+          return false;
+        }
+        std::this_thread::yield();
+      }
+      bias_.store(REVOKED, std::memory_order_release);
+      return true;
+    }
+  };
+
+  using ReTLockBiased = ReTLockBiasedImpl<>;
+}  // namespace retlock
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <retlock/retlock_node_pool.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+namespace retlock {
+
+  /**
+   * @brief A reentrant CLH queue lock.
+   * Waiters spin on the node of their implicit predecessor, so unlock() never waits for a
+   * successor to link itself (unlike the MCS-based ReTLockQueueImpl).
+   * Nodes come from the per-thread NodePool and migrate between threads: unlock() leaves the
+   * holder's node to the successor and takes the predecessor's node in exchange.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   */
+
+  template <bool AdaptiveSleep = false> class ReTLockCLHImpl {
+  public:
+    ReTLockCLHImpl() : tail_(initialTail()), owner_tid_(0), counter_(0), holder_(nullptr) {}
+    ~ReTLockCLHImpl() {
+      // destroyed by its holder: the tail is the holder's node, and the predecessor's goes back
+      if (owner_tid_.load(std::memory_order_relaxed) == getThreadId()) {
+        NodePool<QNode>::local().release(this, holder_->pred_);
+      }
+      // NOTE: not deleted, a try_lock() of another lock may still read it through a stale tail
+      NodePool<QNode>::retire(tail_.load());
+    }
+    ReTLockCLHImpl(const ReTLockCLHImpl&) = delete;
+    ReTLockCLHImpl& operator=(const ReTLockCLHImpl&) = delete;
+
+    void lock() {
+      auto result = try_lock(false);
+      assert(result == true);
+    }
+
+    void unlock() {
+      assert(owner_tid_.load(std::memory_order_relaxed) == getThreadId());
+      assert(counter_ > 0);
+      counter_--;
+      if constexpr (AdaptiveSleep) {
+        if (0 < counter_) {
+          // publish the nesting depth to the successor spinning on my node
+          holder_->locked_.store(counter_);
+        }
+      }
+      if (counter_ > 0) return;
+
+      // release my node to the successor and recycle the predecessor's node
+      auto* node = holder_;
+      owner_tid_.store(0, std::memory_order_relaxed);
+      NodePool<QNode>::local().release(this, node->pred_);
+      node->locked_.store(0, std::memory_order_release);
+    }
+
+    bool try_lock(bool no_wait = true) {
+      const auto tid = getThreadId();
+      if (owner_tid_.load(std::memory_order_relaxed) == tid) {
+        assert(0 < counter_);
+        counter_++;
+        if constexpr (AdaptiveSleep) {
+          holder_->locked_.store(counter_);
+        }
+        return true;
+      }
+
+      // NOTE: pred may be recycled by now, but NodePool never frees a node, so this read is safe
+      QNode* pred = tail_.load();
+      // queue is not empty
+      if (no_wait && pred->locked_.load() != 0) return false;
+
+      // one node per lock instance, so a thread can hold several of them
+      auto& pool = NodePool<QNode>::local();
+      auto* my_node = pool.acquire(this);
+      if (no_wait) {
+        my_node->locked_.store(1, std::memory_order_relaxed);
+        if (!tail_.compare_exchange_strong(pred, my_node)) {
+          my_node->locked_.store(0, std::memory_order_relaxed);
+          pool.release(this, my_node);
+          return false;
+        }
+        // pred may have been recycled and re-enqueued between the load and the CAS (ABA); the
+        // lock is taken then, and try_lock() must not wait for it
+        if (pred->locked_.load(std::memory_order_acquire) != 0) {
+          leave(pred, my_node);
+          return false;
+        }
+      } else {
+        my_node->locked_.store(1, std::memory_order_relaxed);
+        pred = tail_.exchange(my_node);
+      }
+      assert(pred != my_node);
+
+      // wait for unlock
+      for (;;) {
+        auto locked = pred->locked_.load(std::memory_order_acquire);
+        if (locked == 0) break;
+        if (locked == ABANDONED) {
+          // my predecessor left the queue: wait for its own predecessor, and retire its node
+          auto* abandoned = pred;
+          pred = abandoned->pred_;
+          NodePool<QNode>::retire(abandoned);
+          continue;
+        }
+        if constexpr (AdaptiveSleep) {
+          if (1 < locked) {
+            // lock holder is in reentrant mode.
+            // it seems that I should wait for a while.
+            std::this_thread::yield();
+          }
+        }
+      }
+
+      my_node->pred_ = pred;
+      owner_tid_.store(tid, std::memory_order_relaxed);
+      counter_ = 1;
+      holder_ = my_node;
+      return true;
+    }
+
+  private:
+    static constexpr std::size_t cache_line_size() { return 64; }
+
+    /** QNode::locked_ of a try_lock() that left the queue; no nesting depth gets this deep */
+    static constexpr uint32_t ABANDONED = UINT32_MAX;
+
+    struct alignas(cache_line_size()) QNode {
+      // 0: released, otherwise the nesting depth of the holder (AdaptiveSleep) or 1
+      std::atomic<uint32_t> locked_;
+      // the predecessor's node while holding the lock (the pool gets it back on unlock()), or
+      // after leaving the queue (the successor waits for it instead)
+      QNode* pred_;
+      QNode() : locked_(0), pred_(nullptr) {}
+    };
+
+    std::atomic<QNode*> tail_;
+    std::atomic<uint32_t> owner_tid_;
+    uint32_t counter_;
+    // the holder's node; only touched by the holder
+    QNode* holder_;
+
+    /** Takes my_node out of the queue again, where it was enqueued behind pred */
+    void leave(QNode* pred, QNode* my_node) {
+      auto& pool = NodePool<QNode>::local();
+      auto expected = my_node;
+      if (tail_.compare_exchange_strong(expected, pred)) {
+        // nobody saw my node
+        my_node->locked_.store(0, std::memory_order_relaxed);
+        pool.release(this, my_node);
+        return;
+      }
+      // a successor waits on my node already; it skips to pred and retires my node
+      my_node->pred_ = pred;
+      pool.abandon(this);
+      my_node->locked_.store(ABANDONED, std::memory_order_release);
+    }
+
+    static QNode* initialTail() {
+      auto* node = NodePool<QNode>::allocate();
+      node->locked_.store(0, std::memory_order_relaxed);
+      return node;
+    }
+  };
+
+  using ReTLockCLHAFS = ReTLockCLHImpl<true>;
+  using ReTLockCLH = ReTLockCLHImpl<false>;
+}  // namespace retlock
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_node_pool.hpp>
+#include <retlock/retlock_numa.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+namespace retlock {
+
+  /**
+   * @brief A NUMA-aware reentrant cohort lock (C-BO-MCS, Dice et al., PPoPP'12).
+   * A global backoff lock is combined with one MCS queue per NUMA node. The holder passes the
+   * global lock to a waiter of its own node for up to MaxLocalHandoffs times before releasing it,
+   * so the lock word and the protected data stay in one socket's caches.
+   * Queue nodes come from the per-thread NodePool, one per lock instance.
+   * The lock refers to its NumaTopology without copying it, so a topology passed to the
+   * constructor must outlive the lock; NumaTopology::instance() is never freed.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   */
+
+  template <uint32_t MaxLocalHandoffs = 64> class ReTLockCohortImpl {
+  public:
+    ReTLockCohortImpl() : ReTLockCohortImpl(NumaTopology::instance()) {}
+    explicit ReTLockCohortImpl(const NumaTopology& topology)
+        : topology_(&topology),
+          cohorts_(new Cohort[topology.numNodes()]),
+          global_(UNLOCKED),
+          owner_tid_(0),
+          counter_(0),
+          holder_node_(0),
+          holder_qnode_(nullptr) {}
+    explicit ReTLockCohortImpl(const NumaTopology&& topology) = delete;
+    ~ReTLockCohortImpl() {
+      // destroyed by its holder: take the node back
+      if (isAlreadyLocked(getThreadId())) {
+        NodePool<QNode>::local().release(this, holder_qnode_);
+      }
+    }
+    ReTLockCohortImpl(const ReTLockCohortImpl&) = delete;
+    ReTLockCohortImpl& operator=(const ReTLockCohortImpl&) = delete;
+
+    static constexpr uint32_t LOCKED = 1;
+    static constexpr uint32_t UNLOCKED = 0;
+
+    void lock() {
+      const auto tid = getThreadId();
+      if (isAlreadyLocked(tid)) {
+        counter_++;
+        return;
+      }
+
+      const auto node = topology_->currentNode();
+      auto& cohort = cohorts_[node];
+      // one node per lock instance, so a thread can hold several of them
+      auto& pool = NodePool<QNode>::local();
+      auto* my_node = pool.acquire(this);
+      my_node->reset();
+
+      // enqueue to the local queue
+      auto* pred = cohort.tail_.exchange(my_node);
+      auto status = GLOBAL_RELEASE;
+      if (pred != nullptr) {
+        pred->next_.store(my_node);
+        while ((status = my_node->status_.load(std::memory_order_acquire)) == WAITING) {
+          detail::cpuRelax();
+        }
+      }
+
+      // the previous holder may have passed the global lock to the cohort
+      if (status == GLOBAL_RELEASE) {
+        acquireGlobal();
+      }
+      acquired(tid, node, my_node);
+    }
+
+    bool try_lock() {
+      const auto tid = getThreadId();
+      if (isAlreadyLocked(tid)) {
+        counter_++;
+        return true;
+      }
+
+      const auto node = topology_->currentNode();
+      auto& cohort = cohorts_[node];
+      // queue is not empty
+      if (global_.load(std::memory_order_relaxed) == LOCKED
+          || cohort.tail_.load(std::memory_order_relaxed) != nullptr) {
+        return false;
+      }
+
+      auto& pool = NodePool<QNode>::local();
+      auto* my_node = pool.acquire(this);
+      my_node->reset();
+      QNode* expected = nullptr;
+      if (!cohort.tail_.compare_exchange_strong(expected, my_node)) {
+        pool.release(this, my_node);
+        return false;
+      }
+      if (tryAcquireGlobal()) {
+        acquired(tid, node, my_node);
+        return true;
+      }
+
+      // step out of the local queue again; a successor, if any, competes for the global lock
+      releaseLocal(cohort, my_node, GLOBAL_RELEASE);
+      pool.release(this, my_node);
+      return false;
+    }
+
+    void unlock() {
+      assert(isAlreadyLocked(getThreadId()));
+      assert(0 < counter_);
+      counter_--;
+      if (0 < counter_) {
+        return;
+      }
+
+      auto& cohort = cohorts_[holder_node_];
+      auto* my_node = holder_qnode_;
+      owner_tid_.store(0, std::memory_order_relaxed);
+
+      // pass the global lock within the cohort while the bound allows it
+      auto* next = my_node->next_.load();
+      if (next != nullptr && cohort.handoffs_ < MaxLocalHandoffs) {
+        cohort.handoffs_++;
+        next->status_.store(LOCAL_RELEASE, std::memory_order_release);
+      } else {
+        cohort.handoffs_ = 0;
+        global_.store(UNLOCKED, std::memory_order_release);
+        releaseLocal(cohort, my_node, GLOBAL_RELEASE);
+      }
+      NodePool<QNode>::local().release(this, my_node);
+    }
+
+  private:
+    static constexpr std::size_t cache_line_size() { return 64; }
+
+    /** QNode::status_ */
+    static constexpr uint32_t WAITING = 0;
+    static constexpr uint32_t LOCAL_RELEASE = 1;   // the global lock is handed over as well
+    static constexpr uint32_t GLOBAL_RELEASE = 2;  // the successor has to acquire the global lock
+
+    struct alignas(cache_line_size()) QNode {
+      std::atomic<QNode*> next_;
+      std::atomic<uint32_t> status_;
+      QNode() : next_(nullptr), status_(WAITING) {}
+      void reset() { new (this) QNode(); }
+    };
+
+    struct alignas(cache_line_size()) Cohort {
+      std::atomic<QNode*> tail_;
+      // consecutive local handoffs; only touched by the holder
+      uint32_t handoffs_;
+      Cohort() : tail_(nullptr), handoffs_(0) {}
+    };
+
+    /** Members */
+    const NumaTopology* const topology_;
+    std::unique_ptr<Cohort[]> cohorts_;
+    alignas(cache_line_size()) std::atomic<uint32_t> global_;
+    std::atomic<uint32_t> owner_tid_;
+    uint32_t counter_;
+    uint32_t holder_node_;
+    QNode* holder_qnode_;
+
+    inline bool isAlreadyLocked(uint32_t tid) const {
+      return owner_tid_.load(std::memory_order_relaxed) == tid;
+    }
+
+    inline void acquired(uint32_t tid, uint32_t node, QNode* qnode) {
+      assert(counter_ == 0);
+      owner_tid_.store(tid, std::memory_order_relaxed);
+      counter_ = 1;
+      holder_node_ = node;
+      holder_qnode_ = qnode;
+    }
+
+    bool tryAcquireGlobal() {
+      auto expected = UNLOCKED;
+      return global_.load(std::memory_order_relaxed) == UNLOCKED
+             && global_.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire);
+    }
+
+    void acquireGlobal() {
+      // NOTE: only one thread per node competes here, so a short bounded backoff is enough
+      for (size_t i = 0; !tryAcquireGlobal(); ++i) {
+        for (size_t j = 0; j < (size_t(1) << std::min<size_t>(i, 10)); ++j) {
+          detail::cpuRelax();
+        }
+        if (10 < i) std::this_thread::yield();
+      }
+    }
+
+    void releaseLocal(Cohort& cohort, QNode* my_node, uint32_t status) {
+      auto* next = my_node->next_.load();
+      if (next == nullptr) {
+        auto* expected = my_node;
+        // my_node may be the tail_. set tail to nullptr
+        if (cohort.tail_.compare_exchange_strong(expected, nullptr)) {
+          return;
+        }
+        // someone has interleaved.
+        while (next == nullptr) {
+          next = my_node->next_.load();
+        }
+      }
+      next->status_.store(status, std::memory_order_release);
+    }
+  };
+
+  using ReTLockCohort = ReTLockCohortImpl<>;
+}  // namespace retlock
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <new>
+#include <optional>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace retlock {
+
+  /**
+   * @brief A reentrant lock with a flat-combining execute() API.
+   * Contending threads publish their critical section as a closure, and the holder of the lock
+   * (the combiner) runs a batch of them while the protected data is hot in its cache, instead of
+   * bouncing the data between cores. A nested execute() from within a running closure runs inline.
+   * Closures may run on the combiner's thread, so they must not depend on thread-local state.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - execute(F&&)
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   */
+
+  template <uint32_t CombiningRounds = 8> class CombiningLockImpl {
+  public:
+    CombiningLockImpl() : pending_(nullptr), owner_tid_(0), counter_(0) {}
+    CombiningLockImpl(const CombiningLockImpl&) = delete;
+    CombiningLockImpl& operator=(const CombiningLockImpl&) = delete;
+
+    /** Runs `f` under the lock, possibly on another thread, and returns its result */
+    template <typename F> std::invoke_result_t<F&> execute(F&& f) {
+      if (isAlreadyLocked()) {
+        return std::invoke(f);
+      }
+
+      Request<F> request(f);
+      publish(&request);
+      for (size_t i = 0; !request.done_.load(std::memory_order_acquire); ++i) {
+        if (owner_tid_.load(std::memory_order_relaxed) == 0 && try_lock()) {
+          // I am the combiner now; unlock() runs the pending closures, mine included
+          unlock();
+          assert(request.done_.load());
+          break;
+        }
+        backoff(i);
+      }
+      return request.result();
+    }
+
+    void lock() {
+      for (size_t i = 0; !try_lock(); ++i) {
+        backoff(i);
+      }
+    }
+
+    bool try_lock() {
+      const auto tid = getThreadId();
+      auto current = owner_tid_.load(std::memory_order_relaxed);
+      if (current == tid) {
+        assert(0 < counter_);
+        counter_++;
+        return true;
+      }
+      if (current != 0) return false;
+
+      auto success = owner_tid_.compare_exchange_strong(current, tid, std::memory_order_acquire);
+      if (success) {
+        assert(counter_ == 0);
+        counter_ = 1;
+      }
+      return success;
+    }
+
+    void unlock() {
+      assert(isAlreadyLocked());
+      assert(0 < counter_);
+      if (counter_ == 1) {
+        // still the owner while combining, so nested execute() calls run inline
+        combine();
+      }
+      counter_--;
+      if (0 < counter_) {
+        return;
+      }
+      owner_tid_.store(0, std::memory_order_release);
+    }
+
+  private:
+    /** Inner classes */
+    struct RequestBase {
+      void (*invoke_)(RequestBase*);
+      RequestBase* next_;
+      std::atomic<bool> done_;
+      std::exception_ptr error_;
+      explicit RequestBase(void (*invoke)(RequestBase*))
+          : invoke_(invoke), next_(nullptr), done_(false), error_(nullptr) {}
+    };
+
+    template <typename F> struct Request : RequestBase {
+      using R = std::invoke_result_t<F&>;
+      using Storage = std::conditional_t<std::is_reference_v<R>,
+                                         std::reference_wrapper<std::remove_reference_t<R>>, R>;
+
+      F& f_;
+      std::conditional_t<std::is_void_v<R>, bool, std::optional<Storage>> result_;
+
+      explicit Request(F& f) : RequestBase(&Request::invoke), f_(f), result_() {}
+
+      static void invoke(RequestBase* base) {
+        auto* self = static_cast<Request*>(base);
+        if constexpr (std::is_void_v<R>) {
+          std::invoke(self->f_);
+        } else {
+          self->result_.emplace(std::invoke(self->f_));
+        }
+      }
+
+      R result() {
+        if (this->error_) std::rethrow_exception(this->error_);
+        if constexpr (std::is_void_v<R>) {
+          return;
+        } else if constexpr (std::is_reference_v<R>) {
+          return static_cast<R>(result_->get());
+        } else {
+          return std::move(*result_);
+        }
+      }
+    };
+
+    /** Members */
+    std::atomic<RequestBase*> pending_;
+    std::atomic<uint32_t> owner_tid_;
+    uint32_t counter_;
+
+    inline static void backoff(size_t i) {
+      if (i < 64) {
+        detail::cpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    inline bool isAlreadyLocked() const {
+      return owner_tid_.load(std::memory_order_relaxed) == getThreadId();
+    }
+
+    void publish(RequestBase* request) {
+      auto* head = pending_.load(std::memory_order_relaxed);
+      do {
+        request->next_ = head;
+      } while (!pending_.compare_exchange_weak(head, request, std::memory_order_release,
+                                               std::memory_order_relaxed));
+    }
+
+    /** Runs the published closures; only called by the holder */
+    void combine() {
+      for (uint32_t round = 0; round < CombiningRounds; ++round) {
+        auto* batch = pending_.exchange(nullptr, std::memory_order_acquire);
+        if (batch == nullptr) return;
+
+        // the stack is LIFO; serve the batch in publication order
+        RequestBase* ordered = nullptr;
+        while (batch != nullptr) {
+          auto* next = batch->next_;
+          batch->next_ = ordered;
+          ordered = batch;
+          batch = next;
+        }
+
+        while (ordered != nullptr) {
+          // the publisher may return as soon as done_ is set; do not touch it afterwards
+          auto* next = ordered->next_;
+          try {
+            ordered->invoke_(ordered);
+          } catch (...) {
+            ordered->error_ = std::current_exception();
+          }
+          ordered->done_.store(true, std::memory_order_release);
+          ordered = next;
+        }
+      }
+    }
+  };
+
+  using CombiningLock = CombiningLockImpl<>;
+}  // namespace retlock
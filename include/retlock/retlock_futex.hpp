@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+#if defined(__linux__)
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace retlock {
+
+  namespace detail {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+    /**
+     * Block while *word == expected, for at most `timeout` (relative) if given.
+     * May return spuriously; callers must re-check.
+     */
+    inline void futexWait(std::atomic<uint32_t>* word, uint32_t expected,
+                          const struct timespec* timeout = nullptr) {
+#if defined(__linux__)
+      // parked threads are not running, whatever locks they hold
+      BlockingRegion blocked;
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT_PRIVATE, expected, timeout,
+              nullptr, 0);
+#else
+      (void)word;
+      (void)expected;
+      (void)timeout;
+      std::this_thread::yield();
+#endif
+    }
+
+    /** Wake up to `count` threads blocked in futexWait() on `word`. */
+    inline void futexWake(std::atomic<uint32_t>* word, int count) {
+#if defined(__linux__)
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE_PRIVATE, count, nullptr,
+              nullptr, 0);
+#else
+      (void)word;
+      (void)count;
+#endif
+    }
+
+    /** The time left until `deadline`, as a futexWait() timeout; false once it has passed */
+    template <typename Clock, typename Duration>
+    bool timeLeft(const std::chrono::time_point<Clock, Duration>& deadline,
+                  struct timespec& left) {
+      const auto remaining = deadline - Clock::now();
+      if (remaining <= remaining.zero()) return false;
+      const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+      left.tv_sec = static_cast<time_t>(ns / 1000000000);
+      left.tv_nsec = static_cast<long>(ns % 1000000000);
+      return true;
+    }
+  }  // namespace detail
+
+  /**
+   * @brief A reentrant spin-then-park lock backed by futex(2).
+   * Waiters spin for a short while, then sleep in the kernel until the holder releases the lock.
+   * The lock word holds the owner id and a waiter bit, so unlock() only enters the kernel when
+   * someone is actually parked. Falls back to yielding on platforms without futex.
+   * Compatible with std::recurisve_mutex and std::recursive_timed_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   *   - try_lock_for(const std::chrono::duration&)
+   *   - try_lock_until(const std::chrono::time_point&)
+   */
+
+  template <uint32_t SpinCount = 128> class ReTLockFutexImpl {
+  public:
+    ReTLockFutexImpl() : word_(UNLOCKED), counter_(0) {}
+    ReTLockFutexImpl(const ReTLockFutexImpl&) = delete;
+    ReTLockFutexImpl& operator=(const ReTLockFutexImpl&) = delete;
+
+    static constexpr uint32_t UNLOCKED = 0;
+    static constexpr uint32_t WAITERS = 1;
+
+    void lock() {
+      acquire(static_cast<const std::chrono::steady_clock::time_point*>(nullptr));
+    }
+
+    bool try_lock() {
+      auto current = word_.load(std::memory_order_relaxed);
+      if (isAlreadyLocked(current)) {
+        assert(0 < counter_);
+        counter_++;
+        return true;
+      }
+      if (current != UNLOCKED) return false;
+
+      auto success = word_.compare_exchange_strong(current, getThreadId() << 1,
+                                                   std::memory_order_acquire);
+      if (success) {
+        acquired();
+      }
+      return success;
+    }
+
+    void unlock() {
+      assert(isAlreadyLocked(word_.load(std::memory_order_relaxed)));
+      assert(0 < counter_);
+      counter_--;
+      if (0 < counter_) {
+        return;
+      }
+
+      auto previous = word_.exchange(UNLOCKED, std::memory_order_release);
+      if (previous & WAITERS) {
+        detail::futexWake(&word_, 1);
+      }
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+      return try_lock_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <typename Clock, typename Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+      return acquire(&deadline);
+    }
+
+  private:
+    /** Members */
+    // owner_tid << 1 | WAITERS
+    std::atomic<uint32_t> word_;
+    uint32_t counter_;
+
+    template <typename Clock, typename Duration>
+    bool acquire(const std::chrono::time_point<Clock, Duration>* deadline) {
+      if (try_lock()) return true;
+      const uint32_t owned = getThreadId() << 1;
+
+      // spin phase
+      for (uint32_t i = 0; i < SpinCount; ++i) {
+        auto current = word_.load(std::memory_order_relaxed);
+        if (current == UNLOCKED
+            && word_.compare_exchange_weak(current, owned, std::memory_order_acquire)) {
+          acquired();
+          return true;
+        }
+        detail::cpuRelax();
+      }
+      if (deadline != nullptr && *deadline <= Clock::now()) return false;
+
+      // park phase: once parked, I can not tell whether others are still parked, so I acquire
+      // the lock with the waiter bit set and let unlock() wake the next one.
+      for (;;) {
+        auto current = word_.load(std::memory_order_relaxed);
+        if (current == UNLOCKED) {
+          if (word_.compare_exchange_weak(current, owned | WAITERS, std::memory_order_acquire)) {
+            acquired();
+            return true;
+          }
+          continue;
+        }
+        if (!(current & WAITERS)) {
+          if (!word_.compare_exchange_weak(current, current | WAITERS,
+                                           std::memory_order_relaxed)) {
+            continue;
+          }
+          current |= WAITERS;
+        }
+        if (deadline == nullptr) {
+          detail::futexWait(&word_, current);
+          continue;
+        }
+        // NOTE: a waiter that times out leaves the waiter bit behind; unlock() then wakes another
+        // parked waiter, or nobody, which is harmless
+        struct timespec timeout;
+        if (!detail::timeLeft(*deadline, timeout)) return false;
+        detail::futexWait(&word_, current, &timeout);
+      }
+    }
+
+    inline bool isAlreadyLocked(uint32_t current) const {
+      return (current >> 1) == getThreadId();
+    }
+
+    inline void acquired() {
+      assert(counter_ == 0);
+      counter_ = 1;
+    }
+  };
+  static_assert(sizeof(ReTLockFutexImpl<>) == sizeof(uint64_t));
+
+  using ReTLockFutex = ReTLockFutexImpl<>;
+}  // namespace retlock
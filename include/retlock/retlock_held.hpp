@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace retlock {
+
+  /**
+   * @brief The locks held by the calling thread, with their recursion depth.
+   * A small open-addressed hash table keyed by lock address, private to one thread. Locks that
+   * keep their recursion count here can use a bare owner id as the shared lock word, and nested
+   * acquisitions touch thread-local memory only.
+   * Linear probing with backward-shift deletion, so erasing leaves no tombstones behind.
+   * @note
+   * Public Methods:
+   *   - find(const void*)
+   *   - insert(const void*)
+   *   - erase(const void*)
+   *   - size()
+   *   - local()
+   */
+
+  class HeldLockTable {
+  public:
+    static constexpr size_t INITIAL_CAPACITY = 16;
+
+    HeldLockTable() : slots_(INITIAL_CAPACITY), size_(0) {}
+    HeldLockTable(const HeldLockTable&) = delete;
+    HeldLockTable& operator=(const HeldLockTable&) = delete;
+
+    /** The recursion depth of `lock`, or nullptr if the thread does not hold it */
+    uint32_t* find(const void* lock) {
+      for (size_t i = home(lock);; i = next(i)) {
+        auto& slot = slots_[i];
+        if (slot.lock_ == lock) return &slot.depth_;
+        if (slot.lock_ == nullptr) return nullptr;
+      }
+    }
+
+    /** Records `lock` as held once; returns its depth */
+    uint32_t* insert(const void* lock) {
+      assert(lock != nullptr);
+      assert(find(lock) == nullptr);
+      // keep the load factor at most 1/2, so probe sequences stay short
+      if (slots_.size() < (size_ + 1) * 2) {
+        grow();
+      }
+      size_++;
+      return place(lock, 1);
+    }
+
+    /** Forgets `lock`, which the thread must hold */
+    void erase(const void* lock) {
+      auto i = home(lock);
+      while (slots_[i].lock_ != lock) {
+        assert(slots_[i].lock_ != nullptr);
+        i = next(i);
+      }
+      // shift back later entries of the cluster whose home slot is not in (i, j]
+      for (auto j = next(i); slots_[j].lock_ != nullptr; j = next(j)) {
+        const auto h = home(slots_[j].lock_);
+        const bool between = (i < j) ? (i < h && h <= j) : (i < h || h <= j);
+        if (!between) {
+          slots_[i] = slots_[j];
+          i = j;
+        }
+      }
+      slots_[i] = Slot();
+      size_--;
+    }
+
+    /** The number of locks held */
+    size_t size() const { return size_; }
+
+    /** The table of the calling thread */
+    static HeldLockTable& local() {
+      static thread_local HeldLockTable table;
+      return table;
+    }
+
+  private:
+    struct Slot {
+      const void* lock_;
+      uint32_t depth_;
+      Slot() : lock_(nullptr), depth_(0) {}
+    };
+
+    /** Members */
+    // the capacity is a power of two
+    std::vector<Slot> slots_;
+    size_t size_;
+
+    size_t home(const void* lock) const {
+      // Fibonacci hashing; the low bits of an address are mostly zero
+      const auto key = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(lock));
+      return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (slots_.size() - 1);
+    }
+
+    size_t next(size_t i) const { return (i + 1) & (slots_.size() - 1); }
+
+    uint32_t* place(const void* lock, uint32_t depth) {
+      auto i = home(lock);
+      while (slots_[i].lock_ != nullptr) {
+        i = next(i);
+      }
+      slots_[i].lock_ = lock;
+      slots_[i].depth_ = depth;
+      return &slots_[i].depth_;
+    }
+
+    void grow() {
+      std::vector<Slot> old(slots_.size() * 2);
+      old.swap(slots_);
+      for (const auto& slot : old) {
+        if (slot.lock_ != nullptr) {
+          place(slot.lock_, slot.depth_);
+        }
+      }
+    }
+  };
+}  // namespace retlock
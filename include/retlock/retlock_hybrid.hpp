@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+namespace retlock {
+
+  /**
+   * @brief A reentrant lock that switches between test-and-set and MCS queuing at run time.
+   * The lock is always a single owner word taken with a CAS. While contention is low, waiters
+   * spin on the word like ReTLockSameLineImpl. Once a waiter loses the CAS SpinToQueue times,
+   * the lock turns queued: later waiters line up in an MCS queue and only its head competes for
+   * the word, so a release no longer sets off a CAS storm. After QueueToSpin queued acquisitions
+   * in a row that find no one behind them, the lock turns back to test-and-set.
+   * The mode is only a hint for waiters, so switching needs no coordination.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   *   - queued()
+   */
+
+  template <uint32_t SpinToQueue = 16, uint32_t QueueToSpin = 64> class ReTLockHybridImpl {
+  public:
+    ReTLockHybridImpl() : owner_tid_(0), counter_(0), queued_(false), quiet_(0), tail_(nullptr) {}
+    ReTLockHybridImpl(const ReTLockHybridImpl&) = delete;
+    ReTLockHybridImpl& operator=(const ReTLockHybridImpl&) = delete;
+
+    void lock() {
+      const auto tid = getThreadId();
+      if (owner_tid_.load(std::memory_order_relaxed) == tid) {
+        assert(0 < counter_);
+        counter_++;
+        return;
+      }
+
+      if (!queued_.load(std::memory_order_relaxed)) {
+        uint32_t failures = 0;
+        for (size_t i = 0;; ++i) {
+          auto current = owner_tid_.load(std::memory_order_relaxed);
+          if (current == 0) {
+            if (owner_tid_.compare_exchange_strong(current, tid, std::memory_order_acquire)) {
+              acquired();
+              return;
+            }
+            failures++;
+          }
+          if (SpinToQueue <= failures || queued_.load(std::memory_order_relaxed)) break;
+          backoff(i);
+        }
+        queued_.store(true, std::memory_order_relaxed);
+      }
+      lockQueued(tid);
+    }
+
+    bool try_lock() {
+      const auto tid = getThreadId();
+      auto current = owner_tid_.load(std::memory_order_relaxed);
+      if (current == tid) {
+        assert(0 < counter_);
+        counter_++;
+        return true;
+      }
+      if (current != 0) return false;
+      if (!owner_tid_.compare_exchange_strong(current, tid, std::memory_order_acquire)) {
+        return false;
+      }
+      acquired();
+      return true;
+    }
+
+    void unlock() {
+      assert(owner_tid_.load(std::memory_order_relaxed) == getThreadId());
+      assert(0 < counter_);
+      counter_--;
+      if (0 < counter_) {
+        return;
+      }
+
+      owner_tid_.store(0, std::memory_order_release);
+    }
+
+    /** Whether waiters currently queue up */
+    bool queued() const { return queued_.load(std::memory_order_relaxed); }
+
+  private:
+    /** Inner classes */
+    static constexpr std::size_t cache_line_size() { return 64; }
+
+    struct alignas(cache_line_size()) QNode {
+      std::atomic<QNode*> next_;
+      std::atomic<bool> waiting_;
+      QNode() : next_(nullptr), waiting_(false) {}
+    };
+
+    /** Members */
+    std::atomic<uint32_t> owner_tid_;
+    uint32_t counter_;
+    std::atomic<bool> queued_;
+    // queued acquisitions in a row without a successor; guarded by the lock
+    uint32_t quiet_;
+    alignas(cache_line_size()) std::atomic<QNode*> tail_;
+
+    /** A thread waits for one lock at a time, and its node is free again once it is not the head */
+    inline static QNode& getMyNode() {
+      static thread_local QNode node;
+      return node;
+    }
+
+    inline static void backoff(size_t i) {
+      if (i < 1024) {
+        detail::cpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    void lockQueued(uint32_t tid) {
+      auto& my_node = getMyNode();
+      my_node.next_.store(nullptr, std::memory_order_relaxed);
+      my_node.waiting_.store(true, std::memory_order_relaxed);
+      auto* pred = tail_.exchange(&my_node, std::memory_order_acq_rel);
+      if (pred != nullptr) {
+        pred->next_.store(&my_node, std::memory_order_release);
+        for (size_t i = 0; my_node.waiting_.load(std::memory_order_acquire); ++i) {
+          backoff(i);
+        }
+      }
+
+      // head of the queue: only threads that still spin compete with me
+      for (size_t i = 0;; ++i) {
+        auto current = owner_tid_.load(std::memory_order_relaxed);
+        if (current == 0
+            && owner_tid_.compare_exchange_weak(current, tid, std::memory_order_acquire)) {
+          break;
+        }
+        backoff(i);
+      }
+      acquired();
+
+      // hand the head of the queue over, and turn back to test-and-set once it stays empty
+      auto* next = my_node.next_.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        auto expected = &my_node;
+        if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+          if (QueueToSpin <= ++quiet_) {
+            quiet_ = 0;
+            queued_.store(false, std::memory_order_relaxed);
+          }
+          return;
+        }
+        while ((next = my_node.next_.load(std::memory_order_acquire)) == nullptr) {
+          detail::cpuRelax();
+        }
+      }
+      quiet_ = 0;
+      next->waiting_.store(false, std::memory_order_release);
+    }
+
+    inline void acquired() {
+      assert(counter_ == 0);
+      counter_ = 1;
+    }
+  };
+
+  using ReTLockHybrid = ReTLockHybridImpl<>;
+}  // namespace retlock
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <retlock/retlock_sameline.hpp>
+
+namespace retlock {
+
+  /**
+   * @brief A fixed table of N reentrant locks shared by any number of objects.
+   * An object address is hashed to one of the stripes, so millions of objects can be locked with
+   * a few cache lines instead of one embedded lock each. Each stripe sits on its own cache line.
+   * Two objects may share a stripe: locking both from one thread just nests on that stripe, and
+   * every unlock() drops one level, so the depth stays right as long as calls are paired.
+   * @note
+   * Public Methods:
+   *   - lock(const void*)
+   *   - unlock(const void*)
+   *   - try_lock(const void*)
+   *   - stripe(const void*)
+   *   - get(const void*)
+   */
+
+  template <size_t N, typename Lock = ReTLockVanilla> class LockTable {
+    static_assert(0 < N, "A lock table needs at least one stripe");
+
+  public:
+    LockTable() = default;
+    LockTable(const LockTable&) = delete;
+    LockTable& operator=(const LockTable&) = delete;
+
+    /** Holds the stripe of one object for the lifetime of the guard */
+    class Guard {
+    public:
+      Guard(LockTable& table, const void* object) : lock_(table.get(object)) { lock_.lock(); }
+      ~Guard() { lock_.unlock(); }
+      Guard(const Guard&) = delete;
+      Guard& operator=(const Guard&) = delete;
+
+    private:
+      Lock& lock_;
+    };
+
+    void lock(const void* object) { get(object).lock(); }
+
+    void unlock(const void* object) { get(object).unlock(); }
+
+    bool try_lock(const void* object) { return get(object).try_lock(); }
+
+    /** The index of the stripe guarding `object` */
+    inline static size_t stripe(const void* object) {
+      // Fibonacci hashing; the low bits of an address are mostly zero
+      const auto key = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(object));
+      return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) % N;
+    }
+
+    /** The lock guarding `object`, e.g. for std::unique_lock */
+    Lock& get(const void* object) { return stripes_[stripe(object)].lock_; }
+
+  private:
+    /** Inner classes */
+    static constexpr std::size_t cache_line_size() { return 64; }
+
+    struct alignas(cache_line_size()) Stripe {
+      Lock lock_;
+    };
+
+    /** Members */
+    Stripe stripes_[N];
+  };
+}  // namespace retlock
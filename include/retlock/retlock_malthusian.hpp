@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <retlock/retlock.hpp>
+#include <retlock/retlock_futex.hpp>
+#include <retlock/retlock_node_pool.hpp>
+#include <retlock/retlock_queue.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+namespace retlock {
+
+  /**
+   * @brief Concurrency restriction around any lock, after Dice's Malthusian locks.
+   * At most MaxActive threads (0: one per hardware thread) may be waiting for or holding the
+   * lock at once; that is the active set. Threads that arrive while it is full park in a FIFO
+   * passive set, so waiters never outnumber the CPUs and the active ones keep their caches warm.
+   * A thread leaving the active set hands its place to the oldest passive thread every
+   * RotateEvery releases, and whenever it was the last active thread; otherwise it just frees
+   * its place for whoever comes next. A rotated-out thread turns passive on its next
+   * acquisition, which gives long-term fairness. Passive threads also look for a free place
+   * every millisecond, in case the active set shrank without a hand-over. A passive thread
+   * parks on a node from its NodePool, which is never freed, so a late wake-up never touches
+   * freed memory.
+   * Recursion is handled here, so `Lock` is only ever acquired once per holder.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   *   - passive()
+   */
+
+  template <typename Lock, uint32_t MaxActive = 0, uint32_t RotateEvery = 1024>
+  class ReTLockMalthusianImpl {
+    static_assert(0 < RotateEvery, "RotateEvery must be positive");
+
+  public:
+    ReTLockMalthusianImpl()
+        : owner_tid_(0),
+          counter_(0),
+          releases_(0),
+          max_active_(MaxActive != 0 ? MaxActive
+                                     : std::max(1u, std::thread::hardware_concurrency())),
+          active_(0),
+          passives_(0) {}
+    ReTLockMalthusianImpl(const ReTLockMalthusianImpl&) = delete;
+    ReTLockMalthusianImpl& operator=(const ReTLockMalthusianImpl&) = delete;
+
+    void lock() {
+      if (reenter()) return;
+      admit();
+      lock_.lock();
+      acquired();
+    }
+
+    bool try_lock() {
+      if (reenter()) return true;
+      if (!tryAdmit()) return false;
+      if (!lock_.try_lock()) {
+        leave(false);
+        return false;
+      }
+      acquired();
+      return true;
+    }
+
+    void unlock() {
+      assert(owner_tid_.load(std::memory_order_relaxed) == getThreadId());
+      assert(0 < counter_);
+      counter_--;
+      if (0 < counter_) {
+        return;
+      }
+
+      owner_tid_.store(0, std::memory_order_relaxed);
+      // guarded by the lock
+      const bool rotate = ++releases_ % RotateEvery == 0;
+      lock_.unlock();
+      leave(rotate);
+    }
+
+    /** The number of threads parked in the passive set */
+    uint32_t passive() const { return passives_.load(std::memory_order_relaxed); }
+
+  private:
+    /** Inner classes */
+    struct alignas(64) PassiveNode {
+      // 1 once a leaving thread handed its place in the active set over
+      std::atomic<uint32_t> granted_;
+      PassiveNode() : granted_(0) {}
+    };
+
+    static constexpr long RECHECK_NANOS = 1000000;
+
+    /** Members */
+    Lock lock_;
+    std::atomic<uint32_t> owner_tid_;
+    uint32_t counter_;
+    uint32_t releases_;
+    const uint32_t max_active_;
+    alignas(64) std::atomic<uint32_t> active_;
+    std::atomic<uint32_t> passives_;
+    std::mutex passive_mutex_;
+    std::deque<PassiveNode*> passive_;
+
+    inline bool reenter() {
+      if (owner_tid_.load(std::memory_order_relaxed) != getThreadId()) return false;
+      assert(0 < counter_);
+      counter_++;
+      return true;
+    }
+
+    inline void acquired() {
+      assert(counter_ == 0);
+      owner_tid_.store(getThreadId(), std::memory_order_relaxed);
+      counter_ = 1;
+    }
+
+    /** Takes a free place in the active set, if any */
+    bool tryAdmit() {
+      auto active = active_.load(std::memory_order_relaxed);
+      while (active < max_active_) {
+        if (active_.compare_exchange_weak(active, active + 1, std::memory_order_acquire)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /** Joins the active set, parking in the passive set while it is full */
+    void admit() {
+      if (tryAdmit()) return;
+      auto& pool = NodePool<PassiveNode>::local();
+      auto* my_node = pool.acquire(this);
+      my_node->granted_.store(0, std::memory_order_relaxed);
+      {
+        std::lock_guard<std::mutex> guard(passive_mutex_);
+        if (tryAdmit()) {
+          pool.release(this, my_node);
+          return;
+        }
+        passive_.push_back(my_node);
+        passives_.fetch_add(1, std::memory_order_relaxed);
+      }
+      waitPassive(my_node);
+      // NOTE: a late futexWake() may still hit the node once it is reused; that is a spurious
+      // wake-up, and every wait on granted_ rechecks it
+      pool.release(this, my_node);
+    }
+
+    /** Parks until a leaving thread hands its place over, or a place is free */
+    void waitPassive(PassiveNode* my_node) {
+      struct timespec timeout;
+      timeout.tv_sec = 0;
+      timeout.tv_nsec = RECHECK_NANOS;
+      for (;;) {
+        detail::futexWait(&my_node->granted_, 0, &timeout);
+        if (my_node->granted_.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> guard(passive_mutex_);
+        // a hand-over and a free place must not both admit me
+        if (my_node->granted_.load(std::memory_order_acquire)) return;
+        if (tryAdmit()) {
+          passive_.erase(std::find(passive_.begin(), passive_.end(), my_node));
+          passives_.fetch_sub(1, std::memory_order_relaxed);
+          return;
+        }
+      }
+    }
+
+    /** Leaves the active set, handing my place to the oldest passive thread if `rotate` */
+    void leave(bool rotate) {
+      if (0 < passives_.load(std::memory_order_relaxed)
+          && (rotate || active_.load(std::memory_order_relaxed) == 1)) {
+        std::unique_lock<std::mutex> guard(passive_mutex_);
+        if (!passive_.empty()) {
+          auto* next = passive_.front();
+          passive_.pop_front();
+          passives_.fetch_sub(1, std::memory_order_relaxed);
+          // my place goes to `next`, so active_ stays as it is
+          next->granted_.store(1, std::memory_order_release);
+          guard.unlock();
+          // NOTE: `next` may be back in a NodePool, or its thread may have exited, by now; nodes
+          // are never freed, so waking it is at worst a spurious wake-up
+          detail::futexWake(&next->granted_, 1);
+          return;
+        }
+      }
+      active_.fetch_sub(1, std::memory_order_release);
+    }
+  };
+
+  using ReTLockMalthusian = ReTLockMalthusianImpl<ReTLockNoSleepPadding>;
+  using ReTLockMalthusianQueue = ReTLockMalthusianImpl<ReTLockQueue>;
+}  // namespace retlock
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+namespace retlock {
+
+  /**
+   * @brief A per-thread pool of queue nodes for the queue-based locks.
+   * A thread takes a node for every lock instance it holds or waits for, so it can hold many
+   * instances of the same lock type at once. Nodes are heap-allocated and recycled through a free
+   * list; a lock that keeps the node it was handed (like CLH) gives back another node instead.
+   * Each thread owns its pool, so the fast path is not synchronized.
+   * Nodes are never returned to the allocator. When a thread exits, its free nodes are drained to
+   * a process-wide depot, from which pools of new threads refill. Thread pools that shrink and
+   * grow thus reuse the same nodes, and a stale pointer to a node (e.g. CLH's try_lock() reading
+   * the tail) always points at a node, never at freed memory.
+   * @note
+   * Public Methods:
+   *   - find(const void*)
+   *   - acquire(const void*)
+   *   - release(const void*, Node*)
+   *   - abandon(const void*)
+   *   - allocate()
+   *   - retire(Node*)
+   *   - local()
+   */
+
+  template <typename Node> class NodePool {
+  public:
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+    ~NodePool() {
+      // NOTE: nodes still in use belong to a lock the thread exits with; they are left to it
+      auto& depot = getDepot();
+      std::lock_guard<std::mutex> guard(depot.mutex_);
+      depot.nodes_.insert(depot.nodes_.end(), free_.begin(), free_.end());
+    }
+
+    /** The node in use for `lock`, or nullptr */
+    Node* find(const void* lock) const {
+      for (auto it = in_use_.rbegin(); it != in_use_.rend(); ++it) {
+        if (it->lock_ == lock) return it->node_;
+      }
+      return nullptr;
+    }
+
+    /** A node for `lock`; its fields are whatever the previous user left */
+    Node* acquire(const void* lock) {
+      assert(find(lock) == nullptr);
+      if (free_.empty()) {
+        refill();
+      }
+      auto* node = free_.back();
+      free_.pop_back();
+      in_use_.push_back({lock, node});
+      return node;
+    }
+
+    /** Done with `lock`; `recycled` (its node or one received in exchange) goes to the free list */
+    void release(const void* lock, Node* recycled) {
+      erase(lock);
+      free_.push_back(recycled);
+    }
+
+    /** Done with `lock`, but its node stays with the lock, which retires it */
+    void abandon(const void* lock) { erase(lock); }
+
+    /** A node that belongs to no pool (e.g. the initial tail of a lock), taken from the depot */
+    static Node* allocate() {
+      {
+        auto& depot = getDepot();
+        std::lock_guard<std::mutex> guard(depot.mutex_);
+        if (!depot.nodes_.empty()) {
+          auto* node = depot.nodes_.back();
+          depot.nodes_.pop_back();
+          return node;
+        }
+      }
+      return new Node();
+    }
+
+    /** Hands a node no thread uses any more (e.g. the tail of a destroyed lock) to the depot */
+    static void retire(Node* node) {
+      auto& depot = getDepot();
+      std::lock_guard<std::mutex> guard(depot.mutex_);
+      depot.nodes_.push_back(node);
+    }
+
+    /** The pool of the calling thread */
+    static NodePool& local() {
+      static thread_local NodePool pool;
+      return pool;
+    }
+
+  private:
+    // nodes taken from the depot at once
+    static constexpr size_t REFILL_BATCH = 8;
+
+    struct Entry {
+      const void* lock_;
+      Node* node_;
+    };
+
+    struct Depot {
+      std::mutex mutex_;
+      std::vector<Node*> nodes_;
+    };
+
+    // locks are mostly released in LIFO order, so search and erase from the back
+    std::vector<Entry> in_use_;
+    std::vector<Node*> free_;
+
+    inline static Depot& getDepot() {
+      // NOTE: never destroyed, threads may still exit after main() returned
+      static Depot* depot = new Depot();
+      return *depot;
+    }
+
+    void refill() {
+      {
+        auto& depot = getDepot();
+        std::lock_guard<std::mutex> guard(depot.mutex_);
+        for (size_t i = 0; i < REFILL_BATCH && !depot.nodes_.empty(); ++i) {
+          free_.push_back(depot.nodes_.back());
+          depot.nodes_.pop_back();
+        }
+      }
+      if (free_.empty()) {
+        free_.push_back(new Node());
+      }
+    }
+
+    void erase(const void* lock) {
+      for (auto it = in_use_.rbegin(); it != in_use_.rend(); ++it) {
+        if (it->lock_ == lock) {
+          in_use_.erase(std::next(it).base());
+          return;
+        }
+      }
+      assert(false);
+    }
+  };
+}  // namespace retlock
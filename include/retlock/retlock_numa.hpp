@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#  include <sched.h>
+#endif
+
+namespace retlock {
+
+  /**
+   * @brief NUMA topology of the machine, used by the NUMA-aware locks.
+   * Nodes are read from /sys/devices/system/node. Setting the environment variable
+   * RETLOCK_NUMA_NODES=<n> replaces the detected topology with a fake one of n nodes, where
+   * threads are spread over the nodes round-robin. This lets NUMA-aware code paths be exercised on
+   * a single-node machine.
+   * @note
+   * Public Methods:
+   *   - numNodes()
+   *   - nodeOfCpu()
+   *   - currentNode()
+   *   - instance()
+   *   - redetect()
+   */
+
+  class NumaTopology {
+  public:
+    static constexpr const char* FAKE_NODES_ENV = "RETLOCK_NUMA_NODES";
+    static constexpr const char* SYSFS_NODE_DIR = "/sys/devices/system/node";
+
+    /** Detects the topology, honouring RETLOCK_NUMA_NODES */
+    NumaTopology() : fake_(false), num_nodes_(1) {
+      if (const char* fake = std::getenv(FAKE_NODES_ENV)) {
+        auto nodes = std::strtoul(fake, nullptr, 10);
+        if (0 < nodes) {
+          fake_ = true;
+          num_nodes_ = static_cast<uint32_t>(nodes);
+          return;
+        }
+      }
+      detect();
+    }
+
+    /** A fake topology of `nodes` nodes */
+    explicit NumaTopology(uint32_t nodes) : fake_(true), num_nodes_(std::max<uint32_t>(nodes, 1)) {}
+
+    uint32_t numNodes() const { return num_nodes_; }
+    bool isFake() const { return fake_; }
+
+    uint32_t nodeOfCpu(uint32_t cpu) const {
+      if (fake_) return cpu % num_nodes_;
+      return cpu < cpu_to_node_.size() ? cpu_to_node_[cpu] : 0;
+    }
+
+    /** The node the calling thread is running on (a fake topology pins each thread to a node) */
+    uint32_t currentNode() const {
+      if (num_nodes_ == 1) return 0;
+      if (fake_) {
+        static std::atomic<uint32_t> fake_thread_sequence(0);
+        static thread_local uint32_t sequence = fake_thread_sequence.fetch_add(1);
+        return sequence % num_nodes_;
+      }
+#if defined(__linux__)
+      auto cpu = sched_getcpu();
+      if (cpu < 0) return 0;
+      return nodeOfCpu(static_cast<uint32_t>(cpu));
+#else
+      return 0;
+#endif
+    }
+
+    /** The process-wide topology, detected on first use */
+    static const NumaTopology& instance() {
+      auto* topology = current().load(std::memory_order_acquire);
+      return topology != nullptr ? *topology : redetect();
+    }
+
+    /**
+     * Detects the process-wide topology again, e.g. after RETLOCK_NUMA_NODES changed. Locks that
+     * read instance() pick it up on their next acquisition; earlier topologies are never freed,
+     * so references to them stay valid.
+     */
+    static const NumaTopology& redetect() {
+      auto* topology = new NumaTopology();
+      current().store(topology, std::memory_order_release);
+      return *topology;
+    }
+
+  private:
+    bool fake_;
+    uint32_t num_nodes_;
+    std::vector<uint32_t> cpu_to_node_;
+
+    inline static std::atomic<const NumaTopology*>& current() {
+      static std::atomic<const NumaTopology*> topology(nullptr);
+      return topology;
+    }
+
+    void detect() {
+      std::ifstream online(std::string(SYSFS_NODE_DIR) + "/online");
+      std::string nodes;
+      if (!(online >> nodes)) return;
+
+      uint32_t max_node = 0;
+      for (auto node : parseList(nodes)) {
+        std::ifstream cpulist(std::string(SYSFS_NODE_DIR) + "/node" + std::to_string(node)
+                              + "/cpulist");
+        std::string cpus;
+        if (!(cpulist >> cpus)) continue;
+        max_node = std::max(max_node, node);
+        for (auto cpu : parseList(cpus)) {
+          if (cpu_to_node_.size() <= cpu) cpu_to_node_.resize(cpu + 1, 0);
+          cpu_to_node_[cpu] = node;
+        }
+      }
+      num_nodes_ = max_node + 1;
+    }
+
+    /** Parses the sysfs list format, e.g. "0-3,8,10-11" */
+    static std::vector<uint32_t> parseList(const std::string& list) {
+      std::vector<uint32_t> result;
+      std::stringstream ss(list);
+      std::string range;
+      while (std::getline(ss, range, ',')) {
+        if (range.empty()) continue;
+        auto dash = range.find('-');
+        auto first = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+        auto last = dash == std::string::npos
+                        ? first
+                        : static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+        for (auto i = first; i <= last; ++i) {
+          result.push_back(i);
+        }
+      }
+      return result;
+    }
+  };
+}  // namespace retlock
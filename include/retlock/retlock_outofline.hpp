@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <retlock/retlock.hpp>
+#include <retlock/retlock_held.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+namespace retlock {
+
+  /**
+   * @brief A reentrant lock whose recursion count lives out of line.
+   * OutOfLine: the lock word is a bare owner id; the recursion depth is kept in the owner's
+   * HeldLockTable. Nested lock() and unlock() touch thread-local memory only, and the lock takes
+   * four bytes.
+   * Compatible with std::recurisve_mutex and std::recursive_timed_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   *   - try_lock_for(const std::chrono::duration&)
+   *   - try_lock_until(const std::chrono::time_point&)
+   */
+
+  template <SleepType Sleep = SleepType::Exponential> class ReTLockOutOfLineImpl {
+    // NOTE: the adaptive policy of ReTLockImpl reads the holder's depth, which is not shared here
+    static_assert(Sleep != SleepType::Adaptive, "Adaptive sleep is not supported");
+
+  public:
+    ReTLockOutOfLineImpl() : owner_tid_(UNLOCKED) {}
+    ~ReTLockOutOfLineImpl() {
+      // destroyed by its holder: drop the entry, or it would match a later lock at this address
+      if (owner_tid_.load(std::memory_order_relaxed) == getThreadId()) {
+        HeldLockTable::local().erase(this);
+      }
+    }
+    ReTLockOutOfLineImpl(const ReTLockOutOfLineImpl&) = delete;
+    ReTLockOutOfLineImpl& operator=(const ReTLockOutOfLineImpl&) = delete;
+
+    static constexpr uint32_t UNLOCKED = 0;
+
+    void lock() {
+      auto& held = HeldLockTable::local();
+      if (reenter(held)) return;
+      for (size_t i = 0; !tryAcquire(); ++i) {
+        backoff(i);
+      }
+      held.insert(this);
+    }
+
+    bool try_lock() {
+      auto& held = HeldLockTable::local();
+      if (reenter(held)) return true;
+      if (!tryAcquire()) return false;
+      held.insert(this);
+      return true;
+    }
+
+    void unlock() {
+      auto& held = HeldLockTable::local();
+      auto* depth = held.find(this);
+      assert(depth != nullptr);
+      assert(0 < *depth);
+      assert(owner_tid_.load(std::memory_order_relaxed) == getThreadId());
+      (*depth)--;
+      if (0 < *depth) {
+        return;
+      }
+
+      held.erase(this);
+      owner_tid_.store(UNLOCKED, std::memory_order_release);
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+      return try_lock_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <typename Clock, typename Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+      auto& held = HeldLockTable::local();
+      if (reenter(held)) return true;
+      for (size_t i = 0; !tryAcquire(); ++i) {
+        if (deadline <= Clock::now()) return false;
+        backoff(i);
+      }
+      held.insert(this);
+      return true;
+    }
+
+  private:
+    /** Members */
+    std::atomic<uint32_t> owner_tid_;
+
+    inline static void backoff(size_t i) {
+      if constexpr (Sleep == SleepType::NoSleep) {
+        return;
+      } else if constexpr (Sleep == SleepType::Exponential) {
+        detail::sleepExponential(i / 10);
+      } else if constexpr (Sleep == SleepType::Yield) {
+        std::this_thread::yield();
+      } else if constexpr (Sleep == SleepType::Pause) {
+        PauseBackoff<>::pause(i);
+      }
+    }
+
+    inline bool reenter(HeldLockTable& held) {
+      auto* depth = held.find(this);
+      if (depth == nullptr) return false;
+      assert(0 < *depth);
+      (*depth)++;
+      return true;
+    }
+
+    inline bool tryAcquire() {
+      auto current = owner_tid_.load(std::memory_order_relaxed);
+      return current == UNLOCKED
+             && owner_tid_.compare_exchange_weak(current, getThreadId(),
+                                                 std::memory_order_acquire);
+    }
+  };
+  static_assert(sizeof(ReTLockOutOfLineImpl<>) == sizeof(uint32_t));
+
+  using ReTLockOutOfLine = ReTLockOutOfLineImpl<SleepType::Exponential>;
+  using ReTLockOutOfLineYield = ReTLockOutOfLineImpl<SleepType::Yield>;
+  using ReTLockOutOfLineNoSleep = ReTLockOutOfLineImpl<SleepType::NoSleep>;
+  using ReTLockOutOfLinePause = ReTLockOutOfLineImpl<SleepType::Pause>;
+}  // namespace retlock
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_held.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+namespace retlock {
+
+  /**
+   * @brief A reentrant lock in a single 32-bit word, modelled on the Linux kernel qspinlock.
+   * The word holds a locked byte, a pending bit and the tail of an MCS queue, encoded as a thread
+   * index and a nesting index into per-thread blocks of queue nodes. The first contender spins on
+   * the pending bit without a node; further contenders queue up and spin on their own node.
+   * The recursion count is kept out of line, in the owner's HeldLockTable.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   */
+
+  template <uint32_t PendingLoops = 1> class ReTLockQSpinImpl {
+  public:
+    ReTLockQSpinImpl() : word_(0) {}
+    ~ReTLockQSpinImpl() {
+      // destroyed by its holder: drop the entry, or it would match a later lock at this address
+      auto& held = HeldLockTable::local();
+      if (held.find(this) != nullptr) {
+        held.erase(this);
+      }
+    }
+    ReTLockQSpinImpl(const ReTLockQSpinImpl&) = delete;
+    ReTLockQSpinImpl& operator=(const ReTLockQSpinImpl&) = delete;
+
+    /** Layout of word_ */
+    static constexpr uint32_t LOCKED = 1;
+    static constexpr uint32_t LOCKED_MASK = 0xff;
+    static constexpr uint32_t PENDING = uint32_t(1) << 8;
+    static constexpr uint32_t LOCKED_PENDING_MASK = LOCKED_MASK | PENDING;
+    static constexpr uint32_t TAIL_IDX_OFFSET = 16;
+    static constexpr uint32_t TAIL_IDX_BITS = 2;
+    static constexpr uint32_t TAIL_THREAD_OFFSET = TAIL_IDX_OFFSET + TAIL_IDX_BITS;
+    static constexpr uint32_t TAIL_MASK = ~((uint32_t(1) << TAIL_IDX_OFFSET) - 1);
+
+    // queue nodes per thread, and threads that can queue up (the rest spin on the word)
+    static constexpr uint32_t MAX_NESTING = uint32_t(1) << TAIL_IDX_BITS;
+    static constexpr uint32_t MAX_THREADS = (uint32_t(1) << (32 - TAIL_THREAD_OFFSET)) - 1;
+
+    void lock() {
+      auto& held = HeldLockTable::local();
+      if (auto* depth = held.find(this)) {
+        assert(0 < *depth);
+        (*depth)++;
+        return;
+      }
+
+      uint32_t current = 0;
+      if (!word_.compare_exchange_strong(current, LOCKED, std::memory_order_acquire)) {
+        lockSlow(current);
+      }
+      held.insert(this);
+    }
+
+    bool try_lock() {
+      auto& held = HeldLockTable::local();
+      if (auto* depth = held.find(this)) {
+        assert(0 < *depth);
+        (*depth)++;
+        return true;
+      }
+
+      if (!tryLockWord()) return false;
+      held.insert(this);
+      return true;
+    }
+
+    void unlock() {
+      auto& held = HeldLockTable::local();
+      auto* depth = held.find(this);
+      assert(depth != nullptr);
+      assert(0 < *depth);
+      (*depth)--;
+      if (0 < *depth) {
+        return;
+      }
+
+      held.erase(this);
+      word_.fetch_and(~LOCKED_MASK, std::memory_order_release);
+    }
+
+  private:
+    /** Inner classes */
+    static constexpr std::size_t cache_line_size() { return 64; }
+
+    struct alignas(cache_line_size()) QNode {
+      std::atomic<QNode*> next_;
+      // set by the predecessor when I become the head of the queue
+      std::atomic<uint32_t> locked_;
+      QNode() : next_(nullptr), locked_(0) {}
+    };
+
+    struct NodeBlock {
+      QNode nodes_[MAX_NESTING];
+      // nodes in use; only touched by the owning thread
+      uint32_t count_;
+      // the thread index this block belongs to, as encoded in the tail
+      const uint32_t index_;
+      explicit NodeBlock(uint32_t index) : count_(0), index_(index) {}
+    };
+
+    /** Members */
+    std::atomic<uint32_t> word_;
+
+    /** Dense and recycled, so the node blocks of exited threads are reused */
+    inline static uint32_t getThreadIndex() { return getThreadId() - 1; }
+
+    inline static std::array<std::atomic<NodeBlock*>, MAX_THREADS>& nodeBlocks() {
+      static std::array<std::atomic<NodeBlock*>, MAX_THREADS> blocks{};
+      return blocks;
+    }
+
+    /** The node block of the calling thread; nullptr if the thread index does not fit the tail */
+    inline static NodeBlock* getMyNodeBlock() {
+      static thread_local NodeBlock* block = [] {
+        const auto index = getThreadIndex();
+        if (MAX_THREADS <= index) return static_cast<NodeBlock*>(nullptr);
+        // a thread leaves no node in a queue once it holds the lock, so the block of an exited
+        // thread with the same index can be taken over as is
+        auto& slot = nodeBlocks()[index];
+        auto* block = slot.load(std::memory_order_acquire);
+        if (block == nullptr) {
+          block = new NodeBlock(index);
+          slot.store(block, std::memory_order_release);
+        }
+        assert(block->count_ == 0);
+        return block;
+      }();
+      return block;
+    }
+
+    inline static uint32_t encodeTail(uint32_t index, uint32_t idx) {
+      return ((index + 1) << TAIL_THREAD_OFFSET) | (idx << TAIL_IDX_OFFSET);
+    }
+
+    inline static QNode* decodeTail(uint32_t tail) {
+      const auto index = (tail >> TAIL_THREAD_OFFSET) - 1;
+      const auto idx = (tail >> TAIL_IDX_OFFSET) & (MAX_NESTING - 1);
+      return &nodeBlocks()[index].load(std::memory_order_acquire)->nodes_[idx];
+    }
+
+    bool tryLockWord() {
+      auto current = word_.load(std::memory_order_relaxed);
+      return current == 0
+             && word_.compare_exchange_strong(current, LOCKED, std::memory_order_acquire);
+    }
+
+    void lockSlow(uint32_t current) {
+      // a pending waiter is about to take the lock; give it a moment
+      for (uint32_t i = 0; current == PENDING && i < PendingLoops; ++i) {
+        detail::cpuRelax();
+        current = word_.load(std::memory_order_relaxed);
+      }
+
+      if (!(current & ~LOCKED_MASK)) {
+        // only the holder is around: wait as the pending waiter, without a queue node
+        current = word_.fetch_or(PENDING, std::memory_order_acquire);
+        if (!(current & ~LOCKED_MASK)) {
+          while (word_.load(std::memory_order_acquire) & LOCKED_MASK) {
+            detail::cpuRelax();
+          }
+          // clear pending, set locked
+          word_.fetch_add(LOCKED - PENDING, std::memory_order_acquire);
+          return;
+        }
+        // someone else is pending or queued; take my pending bit back if I set it
+        if (!(current & PENDING)) {
+          word_.fetch_and(~PENDING, std::memory_order_relaxed);
+        }
+      }
+
+      lockQueued();
+    }
+
+    void lockQueued() {
+      auto* block = getMyNodeBlock();
+      if (block == nullptr || MAX_NESTING <= block->count_) {
+        // no node to queue with
+        while (!tryLockWord()) {
+          detail::cpuRelax();
+        }
+        return;
+      }
+
+      const auto idx = block->count_++;
+      auto* my_node = &block->nodes_[idx];
+      my_node->next_.store(nullptr, std::memory_order_relaxed);
+      my_node->locked_.store(0, std::memory_order_relaxed);
+      const auto tail = encodeTail(block->index_, idx);
+
+      // the lock may have been released meanwhile
+      if (tryLockWord()) {
+        block->count_--;
+        return;
+      }
+
+      // publish my node as the tail, keeping the locked byte and the pending bit
+      auto current = word_.load(std::memory_order_relaxed);
+      while (!word_.compare_exchange_weak(current, (current & LOCKED_PENDING_MASK) | tail,
+                                          std::memory_order_release, std::memory_order_relaxed)) {
+      }
+      if (current & TAIL_MASK) {
+        decodeTail(current)->next_.store(my_node, std::memory_order_release);
+        while (my_node->locked_.load(std::memory_order_acquire) == 0) {
+          detail::cpuRelax();
+        }
+      }
+
+      // head of the queue: wait for the holder and the pending waiter to leave
+      while ((current = word_.load(std::memory_order_acquire)) & LOCKED_PENDING_MASK) {
+        detail::cpuRelax();
+      }
+
+      // the last one in the queue clears the tail as well
+      if ((current & TAIL_MASK) == tail
+          && word_.compare_exchange_strong(current, LOCKED, std::memory_order_acquire)) {
+        block->count_--;
+        return;
+      }
+      word_.fetch_or(LOCKED, std::memory_order_acquire);
+
+      // make the successor the head of the queue
+      QNode* next = nullptr;
+      while ((next = my_node->next_.load(std::memory_order_acquire)) == nullptr) {
+        detail::cpuRelax();
+      }
+      next->locked_.store(1, std::memory_order_release);
+      block->count_--;
+    }
+  };
+  static_assert(sizeof(ReTLockQSpinImpl<>) == sizeof(uint32_t));
+
+  using ReTLockQSpin = ReTLockQSpinImpl<>;
+}  // namespace retlock
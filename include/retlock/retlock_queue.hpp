@@ -2,7 +2,14 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
 #include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_futex.hpp>
+#include <retlock/retlock_node_pool.hpp>
+#include <retlock/retlock_numa.hpp>
 #include <thread>
 #include <vector>
 #include <memory>
@@ -11,17 +18,45 @@ namespace retlock {
 
   /**
    * @brief An optimized implementation of reentrant locking.
-   * Compatible with std::recurisve_mutex.
+   * Each thread takes a queue node per lock instance from its NodePool, so it can hold or wait for
+   * any number of instances at once; the recursion count lives in that node.
+   * BasicReTLock<QueueLayout, ...> composes the MCS queue with a Wait policy instead; this class
+   * keeps the policies no Wait policy expresses: AdaptiveSleep, NumaAware, Park and TimePublished.
+   * NumaAware: compact NUMA-aware (CNA, Dice and Kogan, EuroSys'19) policy. unlock() prefers a
+   * successor on the holder's socket and parks remote waiters in a secondary queue, which is
+   * passed along with the lock, so the lock itself stays a single tail_ word. Sockets come from
+   * NumaTopology::instance(); setting RETLOCK_NUMA_NODES and calling redetect() fakes several.
+   * Timed waiters that give up mark their node abandoned and leave it in the queue; the releaser
+   * that reaches it releases the lock on its behalf and retires it to the NodePool depot.
+   * Park: a waiter spins for a while, then sleeps in the kernel on its own node's waiting_ word,
+   * flagged so that the predecessor's unlock() wakes exactly that waiter; FIFO order is kept.
+   * TimePublished: waiters publish a heartbeat in their node while they spin, and unlock() skips
+   * a successor whose heartbeat is stale, i.e. which was likely preempted, instead of waiting
+   * for it to run (MCS-TP, He et al., HiPC'05). The skipped waiter queues up again at the tail
+   * once it runs.
+   * Compatible with std::recurisve_mutex and std::recursive_timed_mutex.
    * @note
    * Public Methods:
    *   - lock()
    *   - unlock()
    *   - try_lock()
+   *   - try_lock_for(const std::chrono::duration&)
+   *   - try_lock_until(const std::chrono::time_point&)
+   *   - waiters()
    */
 
-  template <bool AdaptiveSleep = false> class ReTLockQueueImpl {
+  template <bool AdaptiveSleep = false, bool NumaAware = false, bool Park = false,
+            bool TimePublished = false>
+  class ReTLockQueueImpl {
   public:
     ReTLockQueueImpl() : tail_(nullptr) {}
+    ~ReTLockQueueImpl() {
+      // destroyed by its holder: take the node back, or it would match a later lock at this address
+      auto& pool = NodePool<QNode>::local();
+      if (auto* my_node = pool.find(this)) {
+        pool.release(this, my_node);
+      }
+    }
     ReTLockQueueImpl(const ReTLockQueueImpl&) = delete;
     ReTLockQueueImpl& operator=(const ReTLockQueueImpl&) = delete;
 
@@ -31,109 +66,396 @@ namespace retlock {
     }
 
     void unlock() {
-      auto* my_node = getMyQNode();
+      auto& pool = NodePool<QNode>::local();
+      auto* my_node = pool.find(this);
+      assert(my_node != nullptr);
       assert(my_node->counter_ > 0);
       my_node->counter_--;
       if constexpr (AdaptiveSleep) {
-        auto* next = my_node->next_.load();
-        if (next != nullptr) {
-          next->waiting_.store(my_node->counter_);
-	  if (my_node->counter_ == 0) return; // already unlocked.
+        if (0 < my_node->counter_) {
+          auto* next = my_node->next_.load();
+          if (next != nullptr) {
+            publishDepth(next, my_node->counter_);
+          }
         }
       }
       if (my_node->counter_ > 0) return;
 
-      auto* next = my_node->next_.load();
-      if (next == nullptr) {
-        auto* expected = my_node;
-        // my_node may be the tail_. set tail to nullptr
-        if (tail_.compare_exchange_strong(expected, nullptr)) {
-          return;
-        }
-        // someone has interleaved.
-        while (next == nullptr) {
-          next = my_node->next_.load();
+      // successors that abandoned their node refuse the lock; release on their behalf
+      auto* node = my_node;
+      while (node != nullptr) {
+        auto* abandoned = NumaAware ? releaseNumaAware(node) : release(node);
+        if (node != my_node) {
+          if (TimePublished && node->waiting_.load() == SKIPPED) {
+            // done with it: its waiter takes it back and queues up again
+            node->waiting_.store(REQUEUE);
+          } else {
+            // NOTE: not deleted, a late futexWake() may still touch it
+            NodePool<QNode>::retire(node);
+          }
         }
+        node = abandoned;
       }
-      assert(next != nullptr);
-      next->waiting_.store(false);
+      pool.release(this, my_node);
     }
 
     bool try_lock(bool no_wait = true) {
-      auto* my_node = getMyQNode();
+      return acquire(no_wait, static_cast<const std::chrono::steady_clock::time_point*>(nullptr));
+    }
+
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+      return try_lock_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    /** Leaves the queue once the deadline passed; a releaser retires the abandoned node */
+    template <typename Clock, typename Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+      return acquire(false, &deadline);
+    }
+
+    /** The number of nodes queued behind mine, abandoned ones included; only the holder asks */
+    uint32_t waiters() const {
+      auto* my_node = NodePool<QNode>::local().find(this);
+      assert(my_node != nullptr);
+      uint32_t count = 0;
+      for (auto* node = my_node->next_.load(); node != nullptr; node = node->next_.load()) {
+        count++;
+      }
+      if constexpr (NumaAware) {
+        for (auto* node = my_node->sec_head_; node != nullptr;
+             node = node == my_node->sec_tail_ ? nullptr : node->next_.load()) {
+          count++;
+        }
+      }
+      return count;
+    }
+
+  private:
+    static constexpr std::size_t cache_line_size() { return 64; }
+
+    // consecutive handoffs within a socket before the secondary queue is served (CNA)
+    static constexpr uint32_t NUMA_HANDOFF_THRESHOLD = 64;
+
+    // QNode::waiting_ of a waiter that timed out and left its node in the queue
+    static constexpr uint32_t ABANDONED = UINT32_MAX;
 
-      if (0 < my_node->counter_) {
+    // Park: set in QNode::waiting_ by a waiter about to sleep on it
+    static constexpr uint32_t PARKED = uint32_t(1) << 30;
+    static constexpr size_t SPIN_BEFORE_PARK = 512;
+
+    // TimePublished: QNode::waiting_ of a waiter a releaser is passing over, and once it is done
+    static constexpr uint32_t SKIPPED = UINT32_MAX - 1;
+    static constexpr uint32_t REQUEUE = UINT32_MAX - 2;
+    // a waiter publishes its heartbeat every HEARTBEAT_SPINS spins, and is deemed preempted
+    // when it is older than PATIENCE_NANOS
+    static constexpr size_t HEARTBEAT_SPINS = 64;
+    static constexpr uint64_t PATIENCE_NANOS = 100000;
+
+    struct alignas(cache_line_size()) QNode {
+      std::atomic<QNode*> next_;
+      std::atomic<uint32_t> waiting_;
+      // CNA: written by the node's own thread before it enqueues, read by the holders ahead of it
+      uint32_t socket_;
+      // CNA: written by the predecessor before it clears waiting_
+      uint32_t local_handoffs_;
+      QNode* sec_head_;
+      QNode* sec_tail_;
+      // TimePublished: when the waiter last ran
+      std::atomic<uint64_t> heartbeat_;
+      alignas(cache_line_size()) size_t counter_;
+      QNode()
+          : next_(nullptr),
+            waiting_(true),
+            socket_(0),
+            local_handoffs_(0),
+            sec_head_(nullptr),
+            sec_tail_(nullptr),
+            heartbeat_(0),
+            counter_(0) {}
+      void reset() { new (this) QNode(); }
+    };
+
+    std::atomic<QNode*> tail_;
+
+    template <typename Clock, typename Duration>
+    bool acquire(bool no_wait, const std::chrono::time_point<Clock, Duration>* deadline) {
+      // one node per lock instance, so a thread can hold several of them
+      auto& pool = NodePool<QNode>::local();
+      auto* my_node = pool.find(this);
+
+      if (my_node != nullptr) {
+        assert(0 < my_node->counter_);
         assert(my_node->waiting_.load() == false);
         my_node->counter_++;
         if constexpr (AdaptiveSleep) {
           auto* next = my_node->next_.load();
           if (next != nullptr) {
-            next->waiting_.store(my_node->counter_);
+            publishDepth(next, my_node->counter_);
           }
         }
         return true;
       }
 
+      my_node = pool.acquire(this);
       my_node->counter_ = 1;
+      enqueueable(my_node);
+
+      if (no_wait) {
+        // enqueue only into an empty queue, so try_lock() never waits behind a late arrival
+        QNode* expected = nullptr;
+        if (!tail_.compare_exchange_strong(expected, my_node)) {
+          my_node->reset();
+          pool.release(this, my_node);
+          return false;
+        }
+        my_node->waiting_.store(false);
+        return true;
+      }
+
+      for (;;) {
+        // enqueue
+        auto* pred = tail_.exchange(my_node);
+        if (pred != nullptr) {
+          pred->next_.store(my_node);
+        } else {
+          my_node->waiting_.store(false);
+          return true;
+        }
+
+        // wait for unlock
+        for (size_t i = 0;; ++i) {
+          auto waiting = my_node->waiting_.load();
+          if (!waiting) return true;
+          if constexpr (TimePublished) {
+            if (waiting == REQUEUE) break;
+            // the releaser is still passing over my node
+            if (waiting == SKIPPED) {
+              detail::cpuRelax();
+              continue;
+            }
+            if (i % HEARTBEAT_SPINS == 0) {
+              my_node->heartbeat_.store(nowNanos(), std::memory_order_relaxed);
+            }
+          }
+          if (deadline != nullptr && *deadline <= Clock::now() && abandon(my_node)) return false;
+          if constexpr (AdaptiveSleep) {
+            if (1 < (waiting & ~PARKED)) {
+              // lock holder is in reentrant mode.
+              // it seems that I should wait for a while.
+              std::this_thread::yield();
+            }
+          }
+          if constexpr (Park) {
+            if (SPIN_BEFORE_PARK <= i) {
+              park(my_node, waiting, deadline);
+              continue;
+            }
+          }
+          // leave the core to a sibling hyperthread, which may be the owner
+          detail::cpuRelax();
+        }
+
+        // TimePublished: skipped while preempted, and my node is mine again
+        if (deadline != nullptr && *deadline <= Clock::now()) {
+          my_node->reset();
+          pool.release(this, my_node);
+          return false;
+        }
+        enqueueable(my_node);
+      }
+    }
+
+    inline static void enqueueable(QNode* my_node) {
       my_node->next_.store(nullptr);
       my_node->waiting_.store(true);
+      if constexpr (NumaAware) {
+        my_node->socket_ = NumaTopology::instance().currentNode();
+        my_node->sec_head_ = nullptr;
+        my_node->sec_tail_ = nullptr;
+        my_node->local_handoffs_ = 0;
+      }
+      if constexpr (TimePublished) {
+        my_node->heartbeat_.store(nowNanos(), std::memory_order_relaxed);
+      }
+    }
 
-      auto* current = tail_.load();
-      assert(current != my_node);
+    inline static uint64_t nowNanos() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
 
-      // queue is not empty
-      if (current != nullptr && no_wait) {
-        my_node->reset();
-        return false;
+    /** Park: sleeps until my_node->waiting_ changes from `waiting`, or the deadline passes */
+    template <typename Clock, typename Duration>
+    static void park(QNode* my_node, uint32_t waiting,
+                     const std::chrono::time_point<Clock, Duration>* deadline) {
+      // the granter reads PARKED from the same word it clears, so a wake-up can not be missed
+      if (!(waiting & PARKED)) {
+        if (!my_node->waiting_.compare_exchange_strong(waiting, waiting | PARKED)) return;
+        waiting |= PARKED;
+      }
+      if (deadline == nullptr) {
+        detail::futexWait(&my_node->waiting_, waiting);
+        return;
       }
+      struct timespec timeout;
+      if (!detail::timeLeft(*deadline, timeout)) return;
+      detail::futexWait(&my_node->waiting_, waiting, &timeout);
+    }
 
-      // enqueue
-      auto* pred = tail_.exchange(my_node);
-      if (pred != nullptr) {
-        pred->next_.store(my_node);
-      } else {
-        my_node->waiting_.store(false);
-        return true;
+    /** Leaves my_node in the queue for a releaser to skip and retire; fails if already granted */
+    bool abandon(QNode* my_node) {
+      auto waiting = my_node->waiting_.load();
+      // a node being skipped is the releaser's until it hands it back
+      while (waiting != false && waiting < REQUEUE) {
+        if (my_node->waiting_.compare_exchange_weak(waiting, ABANDONED)) {
+          NodePool<QNode>::local().abandon(this);
+          return true;
+        }
       }
+      return false;
+    }
 
-      // wait for unlock
-      for (;;) {
-        auto waiting = my_node->waiting_.load();
-        if (!waiting) return true;
-        if constexpr (AdaptiveSleep) {
-          if (1 < waiting) {
-            // lock holder is in reentrant mode.
-            // it seems that I should wait for a while.
-            std::this_thread::yield();
+    /** AdaptiveSleep: tells the waiter spinning on `next` how deep the holder is */
+    static void publishDepth(QNode* next, size_t depth) {
+      auto waiting = next->waiting_.load();
+      while (waiting != false && waiting < REQUEUE
+             && !next->waiting_.compare_exchange_weak(
+                 waiting, (waiting & PARKED) | static_cast<uint32_t>(depth))) {
+      }
+    }
+
+    /** TimePublished: whether the waiter of `succ` has not run for a while */
+    static bool isStale(QNode* succ) {
+      const auto heartbeat = succ->heartbeat_.load(std::memory_order_relaxed);
+      const auto now = nowNanos();
+      return heartbeat < now && PATIENCE_NANOS < now - heartbeat;
+    }
+
+    /** Hands the lock over to `succ`; fails if it abandoned its node, or if I skip it */
+    static bool grant(QNode* succ) {
+      const bool stale = TimePublished && isStale(succ);
+      auto waiting = succ->waiting_.load();
+      while (waiting != ABANDONED) {
+        // TimePublished: a parked waiter is woken, not skipped
+        if (stale && !(waiting & PARKED)) {
+          if (succ->waiting_.compare_exchange_weak(waiting, SKIPPED)) return false;
+          continue;
+        }
+        if (succ->waiting_.compare_exchange_weak(waiting, false)) {
+          if constexpr (Park) {
+            // NOTE: succ may own the lock and be done with its node by now; nodes are type-stable,
+            // so this is at worst a spurious wake-up
+            if (waiting & PARKED) detail::futexWake(&succ->waiting_, 1);
           }
+          return true;
         }
       }
+      return false;
     }
 
-  private:
-    static constexpr std::size_t cache_line_size() { return 64; }
+    /** Hands the lock and the secondary queue over to `succ`; fails if it abandoned its node */
+    static bool grant(QNode* succ, QNode* sec_head, QNode* sec_tail, uint32_t local_handoffs) {
+      // an abandoned node takes over the secondary queue and is released in turn
+      succ->sec_head_ = sec_head;
+      succ->sec_tail_ = sec_tail;
+      succ->local_handoffs_ = local_handoffs;
+      return grant(succ);
+    }
 
-    struct QNode {
-      std::atomic<QNode*> next_;
-      std::atomic<uint32_t> waiting_;
-      alignas(cache_line_size()) size_t counter_;
-      QNode() : next_(nullptr), waiting_(true), counter_(0) {}
-      void reset() { new (this) QNode(); }
-    };
+    /** Returns the successor if it abandoned or I skipped it, nullptr once the lock is passed on */
+    QNode* release(QNode* node) {
+      auto* next = node->next_.load();
+      if (next == nullptr) {
+        auto* expected = node;
+        // node may be the tail_. set tail to nullptr
+        if (tail_.compare_exchange_strong(expected, nullptr)) {
+          return nullptr;
+        }
+        // someone has interleaved.
+        while (next == nullptr) {
+          next = node->next_.load();
+        }
+      }
+      return grant(next) ? nullptr : next;
+    }
 
-    std::atomic<QNode*> tail_;
+    /**
+     * Finds the first waiter on my socket in the main queue, starting from `next`.
+     * Remote waiters skipped on the way are moved to the tail of the secondary queue.
+     */
+    static QNode* findLocalSuccessor(QNode* my_node, QNode* next) {
+      if (next->socket_ == my_node->socket_) return next;
+
+      auto* skipped_head = next;
+      auto* skipped_tail = next;
+      auto* current = next->next_.load();
+      while (current != nullptr) {
+        if (current->socket_ == my_node->socket_) {
+          skipped_tail->next_.store(nullptr);
+          if (my_node->sec_head_ == nullptr) {
+            my_node->sec_head_ = skipped_head;
+          } else {
+            my_node->sec_tail_->next_.store(skipped_head);
+          }
+          my_node->sec_tail_ = skipped_tail;
+          return current;
+        }
+        skipped_tail = current;
+        current = current->next_.load();
+      }
+      return nullptr;
+    }
+
+    /** Returns the successor if it abandoned or I skipped it, nullptr once the lock is passed on */
+    QNode* releaseNumaAware(QNode* my_node) {
+      auto* next = my_node->next_.load();
+      if (next == nullptr) {
+        auto* expected = my_node;
+        if (my_node->sec_head_ == nullptr) {
+          // my_node may be the tail_. set tail to nullptr
+          if (tail_.compare_exchange_strong(expected, nullptr)) {
+            return nullptr;
+          }
+        } else if (tail_.compare_exchange_strong(expected, my_node->sec_tail_)) {
+          // the main queue is empty: the secondary queue becomes the main queue
+          return grantOrAbandoned(my_node->sec_head_, nullptr, nullptr, 0);
+        }
+        // someone has interleaved.
+        while (next == nullptr) {
+          next = my_node->next_.load();
+        }
+      }
 
-    static std::atomic<uint32_t> thread_id_allocator_;
+      // stay within the socket for a bounded number of handoffs
+      if (my_node->local_handoffs_ < NUMA_HANDOFF_THRESHOLD) {
+        auto* succ = findLocalSuccessor(my_node, next);
+        if (succ != nullptr) {
+          return grantOrAbandoned(succ, my_node->sec_head_, my_node->sec_tail_,
+                                  my_node->local_handoffs_ + 1);
+        }
+      }
+
+      if (my_node->sec_head_ != nullptr) {
+        // serve the remote waiters first, then the rest of the main queue
+        my_node->sec_tail_->next_.store(next);
+        return grantOrAbandoned(my_node->sec_head_, nullptr, nullptr, 0);
+      }
+      return grantOrAbandoned(next, nullptr, nullptr, 0);
+    }
 
-    QNode* getMyQNode() {
-      static thread_local QNode node;
-      return &node;
+    static QNode* grantOrAbandoned(QNode* succ, QNode* sec_head, QNode* sec_tail,
+                                   uint32_t local_handoffs) {
+      return grant(succ, sec_head, sec_tail, local_handoffs) ? nullptr : succ;
     }
   };
 
   using ReTLockQueueAFS = ReTLockQueueImpl<true>;
-  using ReTLockQueue = ReTLockQueueImpl<false>;
+  using ReTLockQueue = ReTLockQueueImpl<>;
+  using ReTLockQueueCNA = ReTLockQueueImpl<false, true>;
+  using ReTLockQueuePark = ReTLockQueueImpl<false, false, true>;
+  using ReTLockQueueTP = ReTLockQueueImpl<false, false, false, true>;
 
-  template <> std::atomic<uint32_t> ReTLockQueueAFS::thread_id_allocator_(0);
-  template <> std::atomic<uint32_t> ReTLockQueue::thread_id_allocator_(0);
+  static_assert(sizeof(ReTLockQueueCNA) == sizeof(void*), "the CNA lock is a single tail word");
 }  // namespace retlock
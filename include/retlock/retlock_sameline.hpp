@@ -4,7 +4,10 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <new>
+#include <retlock/retlock.hpp>
+#include <retlock/retlock_thread.hpp>
 #include <thread>
 
 namespace retlock {
@@ -12,15 +15,18 @@ namespace retlock {
   /**
    * @brief An optimized implementation of reentrant locking.
    * Sameline: this implementation uses the same cache line for the lock and the counter.
-   * Compatible with std::recurisve_mutex.
+   * Compatible with std::recurisve_mutex and std::recursive_timed_mutex.
    * @note
    * Public Methods:
    *   - lock()
    *   - unlock()
    *   - try_lock()
+   *   - try_lock_for(const std::chrono::duration&)
+   *   - try_lock_until(const std::chrono::time_point&)
    */
 
-  enum class SameLineSleepType { NoSleep, Adaptive, Yield, Exponential };
+  /** Shares SleepType with ReTLockImpl; the name is kept for existing code */
+  using SameLineSleepType = SleepType;
 
   template <SameLineSleepType Sleep = SameLineSleepType::Exponential> class ReTLockSameLineImpl {
   public:
@@ -33,30 +39,7 @@ namespace retlock {
 
     void lock() {
       for (size_t i = 0; !try_lock(); ++i) {
-        if constexpr (Sleep == SameLineSleepType::NoSleep) {
-          continue;
-        }
-        if constexpr (Sleep == SameLineSleepType::Adaptive) {
-          auto current = getLocalLockCache();
-          const size_t count = current.counter;
-          // Adaptive: if lock is recursively acquired, sleep with exponential backoff. Otherwise
-          // spin
-          if (count >= 2) {
-            std::this_thread::sleep_for(std::chrono::nanoseconds(1 << (i)));
-          } else {
-            continue;
-          }
-        } else if constexpr (Sleep == SameLineSleepType::Exponential) {
-          std::this_thread::sleep_for(std::chrono::nanoseconds(1 << (i)));
-        } else if constexpr (Sleep == SameLineSleepType::Yield) {
-          std::this_thread::yield();
-        } else {
-          static_assert(
-              Sleep == SameLineSleepType::Adaptive || Sleep == SameLineSleepType::Exponential
-                  || Sleep == SameLineSleepType::Yield || Sleep == SameLineSleepType::NoSleep,
-              "Invalid SameLineSleepType");
-        }
-        // NOTE: glibc uses exponential backoff here
+        backoff(i);
       }
     }
 
@@ -96,6 +79,20 @@ namespace retlock {
       lock_.store(desired);
     }
 
+    template <typename Rep, typename Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout) {
+      return try_lock_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <typename Clock, typename Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+      for (size_t i = 0; !try_lock(); ++i) {
+        if (deadline <= Clock::now()) return false;
+        backoff(i);
+      }
+      return true;
+    }
+
   private:
     /** Inner class */
     struct SameCacheLineContainer {
@@ -110,17 +107,39 @@ namespace retlock {
     /** Members */
     std::atomic<SameCacheLineContainer> lock_;
 
-    static std::atomic<uint32_t> thread_id_allocator_;
-
-    inline static uint32_t getThreadId() {
-      static thread_local uint32_t thread_id = thread_id_allocator_.fetch_add(1);
-      return thread_id;
-    }
-
     inline static SameCacheLineContainer& getLocalLockCache() {
       static thread_local SameCacheLineContainer cache{};
       return cache;
     }
+
+    inline static void backoff(size_t i) {
+      if constexpr (Sleep == SameLineSleepType::NoSleep) {
+        return;
+      }
+      if constexpr (Sleep == SameLineSleepType::Adaptive) {
+        auto current = getLocalLockCache();
+        const size_t count = current.counter;
+        // Adaptive: if lock is recursively acquired, sleep with exponential backoff. Otherwise
+        // spin
+        if (count >= 2) {
+          detail::sleepExponential(i);
+        }
+      } else if constexpr (Sleep == SameLineSleepType::Exponential) {
+        detail::sleepExponential(i);
+      } else if constexpr (Sleep == SameLineSleepType::Yield) {
+        std::this_thread::yield();
+      } else if constexpr (Sleep == SameLineSleepType::Pause) {
+        PauseBackoff<>::pause(i);
+      } else {
+        static_assert(
+            Sleep == SameLineSleepType::Adaptive || Sleep == SameLineSleepType::Exponential
+                || Sleep == SameLineSleepType::Yield || Sleep == SameLineSleepType::NoSleep
+                || Sleep == SameLineSleepType::Pause,
+            "Invalid SameLineSleepType");
+      }
+      // NOTE: glibc uses exponential backoff here
+    }
+
     template <typename T> inline bool isAlreadyLocked(T& current) const {
       return current.owner_tid == getThreadId();
     }
@@ -132,9 +151,5 @@ namespace retlock {
   using ReTLockSameLineYield = ReTLockSameLineImpl<SameLineSleepType::Yield>;
   using ReTLockSameLineAdaptive = ReTLockSameLineImpl<SameLineSleepType::Adaptive>;
   using ReTLockSameLineNoSleep = ReTLockSameLineImpl<SameLineSleepType::NoSleep>;
-
-  template <> std::atomic<uint32_t> ReTLockVanilla::thread_id_allocator_(1);
-  template <> std::atomic<uint32_t> ReTLockSameLineYield::thread_id_allocator_(1);
-  template <> std::atomic<uint32_t> ReTLockSameLineAdaptive::thread_id_allocator_(1);
-  template <> std::atomic<uint32_t> ReTLockSameLineNoSleep::thread_id_allocator_(1);
+  using ReTLockSameLinePause = ReTLockSameLineImpl<SameLineSleepType::Pause>;
 }  // namespace retlock
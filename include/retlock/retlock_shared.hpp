@@ -0,0 +1,253 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+#include <vector>
+
+namespace retlock {
+
+  /**
+   * @brief A reentrant reader-writer lock with scalable read indicators.
+   * Readers take the BRAVO (Dice and Kogan, ATC'19) fast path while the lock is reader-biased:
+   * they publish themselves in a hashed slot of a process-wide visible-readers table instead of
+   * incrementing a shared counter. A writer revokes the bias and waits for those slots to drain;
+   * the bias is re-enabled once an inhibition period proportional to the revocation cost passed.
+   * Both modes are reentrant, and a thread holding the exclusive lock may also lock it shared.
+   * Upgrading a shared lock to an exclusive one is not supported.
+   * Compatible with std::recurisve_mutex and std::shared_lock.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   *   - lock_shared()
+   *   - unlock_shared()
+   *   - try_lock_shared()
+   */
+
+  template <uint32_t InhibitMultiplier = 9> class ReTSharedLockImpl {
+  public:
+    ReTSharedLockImpl() : state_(0), rbias_(true), inhibit_until_(0), counter_(0) {}
+    ReTSharedLockImpl(const ReTSharedLockImpl&) = delete;
+    ReTSharedLockImpl& operator=(const ReTSharedLockImpl&) = delete;
+
+    static constexpr size_t VISIBLE_READERS = 4096;
+
+    void lock() {
+      for (size_t i = 0; !try_lock_exclusive(false); ++i) {
+        backoff(i);
+      }
+    }
+
+    bool try_lock() { return try_lock_exclusive(true); }
+
+    void unlock() {
+      assert(writerOf(state_.load(std::memory_order_relaxed)) == getThreadId());
+      assert(0 < counter_);
+      counter_--;
+      if (0 < counter_) {
+        return;
+      }
+
+      // shared locks taken under the exclusive one survive it as ordinary readers
+      uint32_t readers = 0;
+      for (auto& entry : getReadEntries()) {
+        if (entry.lock_ == this && entry.slot_ == UNDER_WRITE) {
+          entry.slot_ = SLOW;
+          readers = 1;
+        }
+      }
+      state_.store(readers, std::memory_order_release);
+    }
+
+    void lock_shared() {
+      if (reenterShared()) return;
+      if (tryFastShared()) return;
+      for (size_t i = 0; !trySlowShared(); ++i) {
+        backoff(i);
+      }
+    }
+
+    bool try_lock_shared() { return reenterShared() || tryFastShared() || trySlowShared(); }
+
+    void unlock_shared() {
+      auto& entries = getReadEntries();
+      auto entry = findReadEntry(entries);
+      assert(entry != entries.end());
+      assert(0 < entry->depth_);
+      entry->depth_--;
+      if (0 < entry->depth_) {
+        return;
+      }
+
+      if (0 <= entry->slot_) {
+        visibleReaders()[entry->slot_].store(nullptr, std::memory_order_release);
+      } else if (entry->slot_ == SLOW) {
+        state_.fetch_sub(1, std::memory_order_release);
+      }
+      entries.erase(entry);
+    }
+
+  private:
+    /** Inner classes */
+    // slot_ of a ReadEntry: index into the visible-readers table, or one of these
+    static constexpr int32_t SLOW = -1;         // counted in the lower half of state_
+    static constexpr int32_t UNDER_WRITE = -2;  // nested in the exclusive lock of the same thread
+
+    struct ReadEntry {
+      const ReTSharedLockImpl* lock_;
+      uint32_t depth_;
+      int32_t slot_;
+    };
+
+    /** Members */
+    // writer tid << 32 | number of slow-path readers
+    alignas(64) std::atomic<uint64_t> state_;
+    std::atomic<bool> rbias_;
+    std::atomic<int64_t> inhibit_until_;
+    alignas(64) uint32_t counter_;
+
+    inline static std::array<std::atomic<const void*>, VISIBLE_READERS>& visibleReaders() {
+      static std::array<std::atomic<const void*>, VISIBLE_READERS> table{};
+      return table;
+    }
+
+    inline static std::vector<ReadEntry>& getReadEntries() {
+      static thread_local std::vector<ReadEntry> entries;
+      return entries;
+    }
+
+    typename std::vector<ReadEntry>::iterator findReadEntry(std::vector<ReadEntry>& entries) const {
+      for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        if (it->lock_ == this) return std::next(it).base();
+      }
+      return entries.end();
+    }
+
+    inline static uint32_t writerOf(uint64_t state) { return static_cast<uint32_t>(state >> 32); }
+    inline static uint32_t readersOf(uint64_t state) { return static_cast<uint32_t>(state); }
+
+    inline static int64_t now() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+
+    inline size_t slotOf(uint32_t tid) const {
+      auto key = (reinterpret_cast<uintptr_t>(this) >> 6) ^ (uint64_t(tid) << 32);
+      return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 52) % VISIBLE_READERS;
+    }
+
+    inline static void backoff(size_t i) {
+      if (i < 64) {
+        detail::cpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    bool reenterShared() {
+      auto& entries = getReadEntries();
+      auto entry = findReadEntry(entries);
+      if (entry != entries.end()) {
+        entry->depth_++;
+        return true;
+      }
+      if (writerOf(state_.load(std::memory_order_relaxed)) == getThreadId()) {
+        entries.push_back({this, 1, UNDER_WRITE});
+        return true;
+      }
+      return false;
+    }
+
+    bool tryFastShared() {
+      if (!rbias_.load(std::memory_order_acquire)) return false;
+      const auto slot = slotOf(getThreadId());
+      auto& reader = visibleReaders()[slot];
+      const void* expected = nullptr;
+      if (!reader.compare_exchange_strong(expected, this)) return false;
+      // pairs with the bias revocation in revokeBias()
+      if (rbias_.load()) {
+        getReadEntries().push_back({this, 1, static_cast<int32_t>(slot)});
+        return true;
+      }
+      reader.store(nullptr, std::memory_order_release);
+      return false;
+    }
+
+    bool trySlowShared() {
+      auto current = state_.load(std::memory_order_relaxed);
+      if (writerOf(current) != 0
+          || !state_.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) {
+        return false;
+      }
+      getReadEntries().push_back({this, 1, SLOW});
+      // re-enable the reader bias once the inhibition period is over
+      if (!rbias_.load(std::memory_order_relaxed)
+          && inhibit_until_.load(std::memory_order_relaxed) <= now()) {
+        rbias_.store(true);
+      }
+      return true;
+    }
+
+    bool try_lock_exclusive(bool no_wait) {
+      const auto tid = getThreadId();
+      auto current = state_.load(std::memory_order_relaxed);
+      if (writerOf(current) == tid) {
+        assert(0 < counter_);
+        counter_++;
+        return true;
+      }
+      // NOTE: upgrading a shared lock would deadlock
+      assert(findReadEntry(getReadEntries()) == getReadEntries().end());
+
+      if (writerOf(current) != 0) return false;
+      if (no_wait && readersOf(current) != 0) return false;
+      if (!state_.compare_exchange_weak(current, current | (uint64_t(tid) << 32),
+                                        std::memory_order_acquire)) {
+        return false;
+      }
+
+      // wait for the slow-path readers; new ones are blocked by the writer bits
+      for (size_t i = 0; readersOf(state_.load(std::memory_order_acquire)) != 0; ++i) {
+        backoff(i);
+      }
+      if (rbias_.load(std::memory_order_relaxed) && !revokeBias(no_wait)) {
+        state_.store(0, std::memory_order_release);
+        return false;
+      }
+
+      assert(counter_ == 0);
+      counter_ = 1;
+      return true;
+    }
+
+    /** Stops the fast-path readers and waits for the visible ones to leave */
+    bool revokeBias(bool no_wait) {
+      const auto start = now();
+      rbias_.store(false);
+      auto& readers = visibleReaders();
+      for (auto& reader : readers) {
+        for (size_t i = 0; reader.load() == this; ++i) {
+          if (no_wait) {
+            rbias_.store(true);
+            return false;
+          }
+          backoff(i);
+        }
+      }
+      const auto end = now();
+      inhibit_until_.store(end + (end - start) * InhibitMultiplier, std::memory_order_relaxed);
+      return true;
+    }
+  };
+
+  using ReTSharedLock = ReTSharedLockImpl<>;
+}  // namespace retlock
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_futex.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace retlock {
+
+  /**
+   * @brief A reentrant thin lock that inflates to a parking monitor, after Bacon et al.
+   * Thin: the lock word holds the owner id and a 7-bit recursion count, and is taken with a
+   * single CAS. A thread that had to wait for a thin lock, or an owner that overflows the count,
+   * inflates it: the word then names a monitor (a ReTLockFutex from a process-wide pool) on which
+   * contenders park. The last owner deflates the lock back to thin when no one waits on it.
+   * Monitors are never freed, only recycled, so a contender holding a stale monitor index just
+   * locks the monitor, sees that the word changed, and retries. Once all MaxMonitors monitors
+   * are in use, an owner whose count overflows gets std::system_error from lock() and false
+   * from try_lock(), as std::recursive_mutex does beyond its maximum depth.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   *   - inflated()
+   */
+
+  template <uint32_t SpinCount = 64, uint32_t MaxMonitors = (uint32_t(1) << 24)>
+  class ReTLockThinImpl {
+  public:
+    ReTLockThinImpl() : word_(UNLOCKED) {}
+    ~ReTLockThinImpl() {
+      auto current = word_.load(std::memory_order_relaxed);
+      if (!isFat(current)) return;
+      // destroyed by its holder: unwind the monitor before handing it back
+      auto& monitor = getMonitor(indexOf(current));
+      for (; 0 < monitor.depth_; monitor.depth_--) {
+        monitor.lock_.unlock();
+      }
+      releaseMonitor(indexOf(current));
+    }
+    ReTLockThinImpl(const ReTLockThinImpl&) = delete;
+    ReTLockThinImpl& operator=(const ReTLockThinImpl&) = delete;
+
+    /** Layout of word_: owner << OWNER_OFFSET | count << 1 when thin, index << 1 | FAT when fat */
+    static constexpr uint32_t UNLOCKED = 0;
+    static constexpr uint32_t FAT = 1;
+    static constexpr uint32_t COUNT_ONE = 2;
+    static constexpr uint32_t OWNER_OFFSET = 8;
+    static constexpr uint32_t MAX_COUNT = (uint32_t(1) << (OWNER_OFFSET - 1)) - 1;
+
+    void lock() {
+      const auto tid = getThreadId();
+      assert(tid < (uint32_t(1) << (32 - OWNER_OFFSET)));
+      bool contended = false;
+      for (size_t i = 0;; ++i) {
+        auto current = word_.load(std::memory_order_relaxed);
+        if (current == UNLOCKED) {
+          if (word_.compare_exchange_weak(current, thin(tid, 1), std::memory_order_acquire)) {
+            // I had to wait: make the next contenders park instead
+            if (contended) inflate(1);
+            return;
+          }
+          continue;
+        }
+        if (isFat(current)) {
+          if (lockFat(current, false)) return;
+          continue;
+        }
+        if (ownerOf(current) == tid) {
+          if (countOf(current) < MAX_COUNT) {
+            word_.store(current + COUNT_ONE, std::memory_order_relaxed);
+            return;
+          }
+          // NOTE: waiting for a monitor could spin forever, as I may hold the locks that would
+          // release one
+          if (!inflate(MAX_COUNT + 1)) {
+            throw std::system_error(
+                std::make_error_code(std::errc::resource_unavailable_try_again),
+                "retlock: no monitor left to inflate the thin lock");
+          }
+          return;
+        }
+        contended = true;
+        backoff(i);
+      }
+    }
+
+    bool try_lock() {
+      const auto tid = getThreadId();
+      auto current = word_.load(std::memory_order_relaxed);
+      if (current == UNLOCKED) {
+        return word_.compare_exchange_strong(current, thin(tid, 1), std::memory_order_acquire);
+      }
+      if (isFat(current)) return lockFat(current, true);
+      if (ownerOf(current) != tid) return false;
+      if (countOf(current) < MAX_COUNT) {
+        word_.store(current + COUNT_ONE, std::memory_order_relaxed);
+        return true;
+      }
+      return inflate(MAX_COUNT + 1);
+    }
+
+    void unlock() {
+      auto current = word_.load(std::memory_order_relaxed);
+      if (!isFat(current)) {
+        assert(ownerOf(current) == getThreadId());
+        assert(0 < countOf(current));
+        if (1 < countOf(current)) {
+          word_.store(current - COUNT_ONE, std::memory_order_relaxed);
+        } else {
+          word_.store(UNLOCKED, std::memory_order_release);
+        }
+        return;
+      }
+
+      auto& monitor = getMonitor(indexOf(current));
+      assert(0 < monitor.depth_);
+      monitor.depth_--;
+      if (0 < monitor.depth_ || 0 < monitor.waiters_.load()) {
+        monitor.lock_.unlock();
+        return;
+      }
+      // quiet: deflate. A contender that read the old word notices the change once it gets the
+      // monitor, and retries.
+      word_.store(UNLOCKED, std::memory_order_release);
+      monitor.lock_.unlock();
+      releaseMonitor(indexOf(current));
+    }
+
+    /** Whether the lock currently uses a monitor */
+    bool inflated() const { return isFat(word_.load(std::memory_order_relaxed)); }
+
+  private:
+    /** Inner classes */
+    static constexpr std::size_t cache_line_size() { return 64; }
+
+    struct alignas(cache_line_size()) Monitor {
+      ReTLockFutex lock_;
+      // levels held by the owner of the thin lock the monitor stands for; guarded by lock_
+      uint32_t depth_;
+      // threads about to lock or parked on lock_
+      std::atomic<uint32_t> waiters_;
+      Monitor() : depth_(0), waiters_(0) {}
+    };
+
+    static constexpr uint32_t CHUNK_BITS = 10;
+    static constexpr uint32_t CHUNK_SIZE = uint32_t(1) << CHUNK_BITS;
+    static constexpr uint32_t MAX_CHUNKS = MaxMonitors / CHUNK_SIZE;
+    static_assert(0 < MAX_CHUNKS && MaxMonitors % CHUNK_SIZE == 0,
+                  "MaxMonitors must be a positive multiple of 1024");
+
+    struct MonitorPool {
+      std::mutex mutex_;
+      std::vector<uint32_t> free_;
+      uint32_t chunks_in_use_ = 0;
+      // type-stable: chunks are allocated on demand and never freed
+      std::atomic<Monitor*> chunks_[MAX_CHUNKS] = {};
+    };
+
+    /** Members */
+    std::atomic<uint32_t> word_;
+
+    inline static uint32_t thin(uint32_t tid, uint32_t count) {
+      return (tid << OWNER_OFFSET) | (count * COUNT_ONE);
+    }
+    inline static bool isFat(uint32_t word) { return word & FAT; }
+    inline static uint32_t ownerOf(uint32_t word) { return word >> OWNER_OFFSET; }
+    inline static uint32_t countOf(uint32_t word) {
+      return (word & ((uint32_t(1) << OWNER_OFFSET) - 1)) / COUNT_ONE;
+    }
+    inline static uint32_t indexOf(uint32_t word) { return word >> 1; }
+
+    inline static MonitorPool& getMonitorPool() {
+      // NOTE: never destroyed, threads may still exit after main() returned
+      static MonitorPool* pool = new MonitorPool();
+      return *pool;
+    }
+
+    inline static Monitor& getMonitor(uint32_t index) {
+      auto* chunk = getMonitorPool().chunks_[index >> CHUNK_BITS].load(std::memory_order_acquire);
+      return chunk[index & (CHUNK_SIZE - 1)];
+    }
+
+    /** A free monitor index, or false if the pool is exhausted */
+    inline static bool allocateMonitor(uint32_t& index) {
+      auto& pool = getMonitorPool();
+      std::lock_guard<std::mutex> guard(pool.mutex_);
+      if (pool.free_.empty()) {
+        if (MAX_CHUNKS <= pool.chunks_in_use_) return false;
+        const auto base = pool.chunks_in_use_ << CHUNK_BITS;
+        pool.chunks_[pool.chunks_in_use_++].store(new Monitor[CHUNK_SIZE],
+                                                  std::memory_order_release);
+        for (uint32_t i = CHUNK_SIZE; 0 < i; --i) {
+          pool.free_.push_back(base + i - 1);
+        }
+      }
+      index = pool.free_.back();
+      pool.free_.pop_back();
+      return true;
+    }
+
+    inline static void releaseMonitor(uint32_t index) {
+      auto& pool = getMonitorPool();
+      std::lock_guard<std::mutex> guard(pool.mutex_);
+      pool.free_.push_back(index);
+    }
+
+    inline static void backoff(size_t i) {
+      if (i < SpinCount) {
+        detail::cpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    /** Moves the thin lock I hold `depth` times onto a monitor; false if none is available */
+    bool inflate(uint32_t depth) {
+      uint32_t index = 0;
+      if (!allocateMonitor(index)) return false;
+      auto& monitor = getMonitor(index);
+      // a contender may hold the monitor for a moment, having read a stale word
+      for (uint32_t i = 0; i < depth; ++i) {
+        monitor.lock_.lock();
+      }
+      assert(monitor.depth_ == 0);
+      monitor.depth_ = depth;
+      word_.store((index << 1) | FAT, std::memory_order_release);
+      return true;
+    }
+
+    /** Locks the monitor named by `current`; false if the word changed meanwhile */
+    bool lockFat(uint32_t current, bool no_wait) {
+      auto& monitor = getMonitor(indexOf(current));
+      if (no_wait) {
+        if (!monitor.lock_.try_lock()) return false;
+      } else {
+        monitor.waiters_.fetch_add(1);
+        monitor.lock_.lock();
+        monitor.waiters_.fetch_sub(1);
+      }
+      if (word_.load(std::memory_order_acquire) != current) {
+        // deflated, or the monitor now stands for another lock
+        monitor.lock_.unlock();
+        return false;
+      }
+      monitor.depth_++;
+      return true;
+    }
+  };
+  static_assert(sizeof(ReTLockThinImpl<>) == sizeof(uint32_t));
+
+  using ReTLockThin = ReTLockThinImpl<>;
+}  // namespace retlock
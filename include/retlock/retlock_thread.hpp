@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+namespace retlock {
+
+  /**
+   * @brief Process-wide registry of thread ids shared by all locks.
+   * Ids start at 1 (0 stands for "unowned" in the lock words), are handed out smallest-first and
+   * are returned when the thread exits, so they stay dense and can index per-thread arrays.
+   * A thread must not exit while holding a lock: its id may be given to the next thread.
+   * Each id also has a "running" flag, cleared while its thread blocks (see BlockingRegion), so
+   * waiters can tell whether spinning behind the owner of a lock makes sense.
+   * Everything is defined inline, so the headers can be included from any number of translation
+   * units.
+   * @note
+   * Public Methods:
+   *   - currentId()
+   *   - maxId()
+   *   - liveThreads()
+   *   - isRunning(uint32_t)
+   *   - setRunning(bool)
+   */
+
+  class ThreadRegistry {
+  public:
+    static constexpr uint32_t INVALID_ID = 0;
+
+    /** The id of the calling thread */
+    inline static uint32_t currentId() {
+      // trivially destructible, so it stays readable while other thread_locals are destroyed
+      static thread_local uint32_t id = INVALID_ID;
+      if (id == INVALID_ID) {
+        id = attach(id);
+      }
+      return id;
+    }
+
+    /** The largest id handed out so far; every id is in [1, maxId()] */
+    inline static uint32_t maxId() { return instance().max_id_.load(std::memory_order_acquire); }
+
+    /** The number of threads holding an id */
+    inline static uint32_t liveThreads() {
+      return instance().live_threads_.load(std::memory_order_relaxed);
+    }
+
+    /** Whether the thread with `id` is not blocked; unknown ids count as running */
+    inline static bool isRunning(uint32_t id) {
+      auto* flag = instance().runningFlag(id);
+      return flag == nullptr || flag->load(std::memory_order_relaxed);
+    }
+
+    /** Marks the calling thread as running or blocked; returns the previous state */
+    inline static bool setRunning(bool running) {
+      return instance().runningFlag(currentId())->exchange(running, std::memory_order_relaxed);
+    }
+
+  private:
+    ThreadRegistry() : max_id_(INVALID_ID), live_threads_(0) {}
+
+    static constexpr uint32_t CHUNK_BITS = 10;
+    static constexpr uint32_t CHUNK_SIZE = uint32_t(1) << CHUNK_BITS;
+    static constexpr uint32_t MAX_CHUNKS = uint32_t(1) << 12;
+
+    std::mutex mutex_;
+    // released ids, smallest first
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> free_ids_;
+    std::atomic<uint32_t> max_id_;
+    std::atomic<uint32_t> live_threads_;
+    // running flags indexed by id; type-stable: chunks are allocated on demand and never freed
+    std::atomic<std::atomic<bool>*> running_[MAX_CHUNKS] = {};
+
+    inline static ThreadRegistry& instance() {
+      // NOTE: never destroyed, threads may still exit after main() returned
+      static ThreadRegistry* registry = new ThreadRegistry();
+      return *registry;
+    }
+
+    std::atomic<bool>* runningFlag(uint32_t id) {
+      if (MAX_CHUNKS <= (id >> CHUNK_BITS)) return nullptr;
+      auto* chunk = running_[id >> CHUNK_BITS].load(std::memory_order_acquire);
+      return chunk == nullptr ? nullptr : &chunk[id & (CHUNK_SIZE - 1)];
+    }
+
+    uint32_t acquire() {
+      std::lock_guard<std::mutex> guard(mutex_);
+      live_threads_.fetch_add(1, std::memory_order_relaxed);
+      uint32_t id = INVALID_ID;
+      if (!free_ids_.empty()) {
+        id = free_ids_.top();
+        free_ids_.pop();
+      } else {
+        id = max_id_.fetch_add(1, std::memory_order_release) + 1;
+      }
+      if (runningFlag(id) == nullptr && (id >> CHUNK_BITS) < MAX_CHUNKS) {
+        auto* chunk = new std::atomic<bool>[CHUNK_SIZE];
+        for (uint32_t i = 0; i < CHUNK_SIZE; ++i) {
+          chunk[i].store(true, std::memory_order_relaxed);
+        }
+        running_[id >> CHUNK_BITS].store(chunk, std::memory_order_release);
+      }
+      if (auto* flag = runningFlag(id)) {
+        flag->store(true, std::memory_order_relaxed);
+      }
+      return id;
+    }
+
+    void release(uint32_t id) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      live_threads_.fetch_sub(1, std::memory_order_relaxed);
+      free_ids_.push(id);
+    }
+
+    /** Allocates an id for the calling thread and returns it to the registry on thread exit */
+    static uint32_t attach(uint32_t& slot) {
+      struct Releaser {
+        uint32_t* slot_;
+        ~Releaser() {
+          instance().release(*slot_);
+          *slot_ = INVALID_ID;
+        }
+      };
+      // NOTE: a thread that asks again after its Releaser ran keeps its second id for good
+      static thread_local Releaser releaser{&slot};
+      (void)releaser;
+      return instance().acquire();
+    }
+  };
+
+  /** Shorthand for ThreadRegistry::currentId() */
+  inline uint32_t getThreadId() { return ThreadRegistry::currentId(); }
+
+  /**
+   * @brief Marks the calling thread as blocked for its lifetime.
+   * Wrap calls that may sleep (I/O, condition variables, sleeps) while holding a lock, so that
+   * owner-aware waiters park instead of spinning behind this thread. Regions may nest.
+   */
+  class BlockingRegion {
+  public:
+    BlockingRegion() : was_running_(ThreadRegistry::setRunning(false)) {}
+    ~BlockingRegion() { ThreadRegistry::setRunning(was_running_); }
+    BlockingRegion(const BlockingRegion&) = delete;
+    BlockingRegion& operator=(const BlockingRegion&) = delete;
+
+  private:
+    bool was_running_;
+  };
+}  // namespace retlock
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <thread>
+
+namespace retlock {
+
+  /**
+   * @brief A reentrant ticket lock with proportional backoff.
+   * FIFO: threads are served in the order they drew their ticket, so a releasing thread can not
+   * barge in front of the waiters (unlike the CAS race in ReTLockImpl::try_lock()).
+   * Both tickets share a single 8-byte word, and no per-thread queue node is needed.
+   * A waiter spins BackoffBase pauses per holder ahead of it, at most BackoffCap pauses.
+   * Compatible with std::recurisve_mutex.
+   * @note
+   * Public Methods:
+   *   - lock()
+   *   - unlock()
+   *   - try_lock()
+   */
+
+  template <uint32_t BackoffBase = 64, uint32_t BackoffCap = 4096> class ReTLockTicketImpl {
+    static_assert(0 < BackoffBase && BackoffBase <= BackoffCap, "Invalid backoff window");
+
+  public:
+    ReTLockTicketImpl() : ticket_(0), owner_tid_(0), counter_(0) {}
+    ReTLockTicketImpl(const ReTLockTicketImpl&) = delete;
+    ReTLockTicketImpl& operator=(const ReTLockTicketImpl&) = delete;
+
+    void lock() {
+      const auto tid = getThreadId();
+      if (owner_tid_.load(std::memory_order_relaxed) == tid) {
+        assert(0 < counter_);
+        counter_++;
+        return;
+      }
+
+      const uint32_t my_ticket = nextOf(ticket_.fetch_add(NEXT_ONE, std::memory_order_acquire));
+      for (;;) {
+        const uint32_t distance = my_ticket - servingOf(ticket_.load(std::memory_order_acquire));
+        if (distance == 0) break;
+        // back off in proportion to the number of holders ahead of me, up to the cap
+        const uint64_t spins
+            = std::min<uint64_t>(static_cast<uint64_t>(distance) * BackoffBase, BackoffCap);
+        for (uint64_t i = 0; i < spins; ++i) {
+          detail::cpuRelax();
+        }
+      }
+
+      acquired(tid);
+    }
+
+    bool try_lock() {
+      const auto tid = getThreadId();
+      if (owner_tid_.load(std::memory_order_relaxed) == tid) {
+        assert(0 < counter_);
+        counter_++;
+        return true;
+      }
+
+      auto current = ticket_.load(std::memory_order_relaxed);
+      if (nextOf(current) != servingOf(current)) return false;
+      if (!ticket_.compare_exchange_strong(current, current + NEXT_ONE,
+                                           std::memory_order_acquire)) {
+        return false;
+      }
+
+      acquired(tid);
+      return true;
+    }
+
+    void unlock() {
+      assert(owner_tid_.load(std::memory_order_relaxed) == getThreadId());
+      assert(0 < counter_);
+      counter_--;
+      if (0 < counter_) {
+        return;
+      }
+
+      owner_tid_.store(0, std::memory_order_relaxed);
+      // only the holder advances `serving`, so wrap it by hand to keep the carry out of `next`
+      if (servingOf(ticket_.load(std::memory_order_relaxed))
+          == std::numeric_limits<uint32_t>::max()) {
+        ticket_.fetch_sub(std::numeric_limits<uint32_t>::max(), std::memory_order_release);
+      } else {
+        ticket_.fetch_add(1, std::memory_order_release);
+      }
+    }
+
+  private:
+    /** Layout of ticket_: upper 32 bits are the next ticket, lower 32 bits are the serving one */
+    static constexpr uint64_t NEXT_ONE = uint64_t(1) << 32;
+
+    /** Members */
+    std::atomic<uint64_t> ticket_;
+    std::atomic<uint32_t> owner_tid_;
+    uint32_t counter_;
+
+    inline static uint32_t nextOf(uint64_t ticket) { return static_cast<uint32_t>(ticket >> 32); }
+    inline static uint32_t servingOf(uint64_t ticket) { return static_cast<uint32_t>(ticket); }
+
+    inline void acquired(uint32_t tid) {
+      assert(counter_ == 0);
+      owner_tid_.store(tid, std::memory_order_relaxed);
+      counter_ = 1;
+    }
+  };
+  static_assert(sizeof(ReTLockTicketImpl<>) == 2 * sizeof(uint64_t));
+
+  using ReTLockTicket = ReTLockTicketImpl<>;
+}  // namespace retlock
@@ -1,3 +1,18 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 
 #include <doctest/doctest.h>
+
+// a second translation unit including the headers: catches multiply defined symbols at link time
+#include <retlock/retlock.hpp>
+#include <retlock/retlock_arena.hpp>
+#include <retlock/retlock_basic.hpp>
+#include <retlock/retlock_hybrid.hpp>
+#include <retlock/retlock_lock_table.hpp>
+#include <retlock/retlock_malthusian.hpp>
+#include <retlock/retlock_numa.hpp>
+#include <retlock/retlock_outofline.hpp>
+#include <retlock/retlock_qspin.hpp>
+#include <retlock/retlock_queue.hpp>
+#include <retlock/retlock_sameline.hpp>
+#include <retlock/retlock_thin.hpp>
+#include <retlock/retlock_thread.hpp>
@@ -1,24 +1,96 @@
 #include <doctest/doctest.h>
 #include <retlock/version.h>
 
+#include <pthread.h>
+
 #include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <retlock/retlock.hpp>
+#include <retlock/retlock_arena.hpp>
+#include <retlock/retlock_backoff.hpp>
+#include <retlock/retlock_basic.hpp>
+#include <retlock/retlock_biased.hpp>
+#include <retlock/retlock_clh.hpp>
+#include <retlock/retlock_cohort.hpp>
+#include <retlock/retlock_combining.hpp>
+#include <retlock/retlock_futex.hpp>
+#include <retlock/retlock_held.hpp>
+#include <retlock/retlock_hybrid.hpp>
+#include <retlock/retlock_lock_table.hpp>
+#include <retlock/retlock_malthusian.hpp>
+#include <retlock/retlock_numa.hpp>
+#include <retlock/retlock_outofline.hpp>
+#include <retlock/retlock_qspin.hpp>
 #include <retlock/retlock_queue.hpp>
 #include <retlock/retlock_sameline.hpp>
+#include <retlock/retlock_shared.hpp>
+#include <retlock/retlock_thin.hpp>
+#include <retlock/retlock_thread.hpp>
+#include <retlock/retlock_ticket.hpp>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <vector>
 
 /**
  * Testing Classes
  */
 #define RECURSIVE_LOCK                                                                            \
-  std::recursive_mutex, retlock::ReTLockQueue, retlock::ReTLockQueueAFS, retlock::ReTLockVanilla, \
-      retlock::ReTLockSameLineYield, retlock::ReTLockSameLineAdaptive,                            \
-      retlock::ReTLockSameLineNoSleep, retlock::ReTLockPadding, retlock::ReTLockYieldPadding,     \
-      retlock::ReTLockAdaptivePadding, retlock::ReTLockNoSleepPadding
+  std::recursive_mutex, retlock::ReTLockQueue, retlock::ReTLockQueueAFS,                          \
+      retlock::ReTLockQueueCNA, retlock::ReTLockCLH, retlock::ReTLockCLHAFS,                      \
+      retlock::ReTLockTicket, retlock::ReTLockFutex, retlock::ReTLockQSpin,                       \
+      retlock::ReTLockCohort, retlock::CombiningLock, retlock::ReTSharedLock,                     \
+      retlock::ReTLockBiased, retlock::ReTLockVanilla, retlock::ReTLockSameLineYield,             \
+      retlock::ReTLockSameLineAdaptive, retlock::ReTLockSameLineNoSleep, retlock::ReTLockPadding, \
+      retlock::ReTLockYieldPadding, retlock::ReTLockAdaptivePadding,                              \
+      retlock::ReTLockNoSleepPadding, retlock::ReTLockOutOfLine, retlock::ReTLockOutOfLineYield,  \
+      retlock::ReTLockOutOfLineNoSleep, retlock::ReTLockThin, retlock::ReTLockPaddedFutex,        \
+      retlock::ReTLockSameLineFutex, retlock::ReTLockQueueSpin, retlock::ReTLockQueueFutex,       \
+      retlock::ReTLockPaddedOutOfLine, retlock::ReTLockHybrid, retlock::ReTLockPausePadding,      \
+      retlock::ReTLockSameLinePause, retlock::ReTLockOutOfLinePause, retlock::ReTLockQueuePause,  \
+      retlock::ReTLockSameLineOwnerAware, retlock::ReTLockQueueOwnerAware,                        \
+      retlock::ReTLockMalthusian, retlock::ReTLockMalthusianQueue, retlock::ReTLockQueuePark,     \
+      retlock::ReTLockQueueTP
 #define NORMAL_LOCK RECURSIVE_LOCK, std::mutex
+#define QUEUE_LOCK                                                                                \
+  retlock::ReTLockQueue, retlock::ReTLockQueueAFS, retlock::ReTLockQueueCNA, retlock::ReTLockCLH, \
+      retlock::ReTLockCLHAFS, retlock::ReTLockCohort, retlock::ReTLockQSpin,                      \
+      retlock::ReTLockQueuePark, retlock::ReTLockQueueTP
+#define TIMED_LOCK                                                                                \
+  std::recursive_timed_mutex, retlock::ReTLockQueue, retlock::ReTLockQueueAFS,                    \
+      retlock::ReTLockQueueCNA, retlock::ReTLockFutex, retlock::ReTLockVanilla,                   \
+      retlock::ReTLockSameLineYield, retlock::ReTLockPadding, retlock::ReTLockYieldPadding,       \
+      retlock::ReTLockOutOfLine, retlock::ReTLockQueuePark, retlock::ReTLockQueueTP
+#define PARKING_LOCK retlock::ReTLockFutex, retlock::ReTLockQueuePark, retlock::ReTLockPaddedFutex
+
+/** Four threads each take the lock twice over 500 times; returns the final count */
+template <typename T> size_t contendNested(T& l) {
+  size_t counter = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 500; ++j) {
+        std::unique_lock<T> ul(l);
+        std::unique_lock<T> ul2(l);
+        counter++;
+        if (j % 100 == 0) std::this_thread::yield();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  return counter;
+}
 
 /** Test cases for Exclusive Locking */
 TEST_SUITE("Ordinary Lock"
@@ -119,3 +191,1250 @@ TEST_SUITE("Reentrant Lock"
     });
   }
 }
+
+/** Test cases for Parking */
+TEST_SUITE("Parking Lock" * doctest::description("Waiters sleep and are woken on release")) {
+  TEST_CASE_TEMPLATE("parked waiters are woken by unlock", T, PARKING_LOCK) {
+    T l;
+    std::atomic<int> acquired(0);
+    l.lock();
+    l.lock();
+    std::vector<std::thread> waiters;
+    std::atomic<uint32_t> ids[2];
+    for (int i = 0; i < 2; ++i) {
+      ids[i].store(retlock::ThreadRegistry::INVALID_ID);
+      waiters.emplace_back([&, i] {
+        ids[i].store(retlock::getThreadId());
+        std::unique_lock<T> ul(l);
+        acquired++;
+      });
+    }
+    // a parked waiter sleeps in a blocking region, which clears its running flag
+    for (auto& id : ids) {
+      while (retlock::ThreadRegistry::isRunning(id.load())) std::this_thread::yield();
+    }
+    CHECK(acquired.load() == 0);
+    l.unlock();
+    CHECK(acquired.load() == 0);
+    l.unlock();
+    for (auto& t : waiters) {
+      t.join();
+    }
+    CHECK(acquired.load() == 2);
+  }
+
+  TEST_CASE("parked queue waiters keep FIFO order") {
+    retlock::ReTLockQueuePark l;
+    std::vector<int> order;
+    l.lock();
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 3; ++i) {
+      std::atomic<uint32_t> id(retlock::ThreadRegistry::INVALID_ID);
+      waiters.emplace_back([&, i] {
+        id.store(retlock::getThreadId());
+        std::lock_guard<retlock::ReTLockQueuePark> guard(l);
+        order.push_back(i);
+      });
+      // enqueued and parked before the next one arrives
+      while (retlock::ThreadRegistry::isRunning(id.load())) std::this_thread::yield();
+    }
+    l.unlock();
+    for (auto& t : waiters) {
+      t.join();
+    }
+    CHECK(order == std::vector<int>{0, 1, 2});
+  }
+}
+
+/** Test cases for time-published queue locking */
+std::atomic<bool> preempted(false);
+std::atomic<bool> resumed(false);
+
+TEST_SUITE("Time-Published Lock" * doctest::description("Preempted waiters are skipped")) {
+  TEST_CASE("the lock goes to the next live waiter") {
+    retlock::ReTLockQueueTP l;
+    std::mutex order_mutex;
+    std::vector<int> order;
+    auto waiter = [&](int id) {
+      std::lock_guard<retlock::ReTLockQueueTP> guard(l);
+      std::lock_guard<std::mutex> order_guard(order_mutex);
+      order.push_back(id);
+    };
+    auto served = [&] {
+      std::lock_guard<std::mutex> order_guard(order_mutex);
+      return order.size();
+    };
+    // a signal handler that blocks until resumed stands in for a preemption
+    preempted.store(false);
+    resumed.store(false);
+    auto previous = std::signal(SIGUSR1, [](int) {
+      preempted.store(true);
+      while (!resumed.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+
+    l.lock();
+    std::thread first(waiter, 0);
+    while (l.waiters() < 1) std::this_thread::yield();
+    pthread_kill(first.native_handle(), SIGUSR1);
+    while (!preempted.load()) std::this_thread::yield();
+    std::thread second(waiter, 1);
+    while (l.waiters() < 2) std::this_thread::yield();
+    // let the heartbeat of the preempted waiter go stale
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    l.unlock();
+    while (served() < 1) std::this_thread::yield();
+    resumed.store(true);
+    first.join();
+    second.join();
+    std::signal(SIGUSR1, previous);
+    CHECK(order == std::vector<int>{1, 0});
+  }
+}
+
+/** Fakes NUMA nodes in the process-wide topology while in scope */
+struct FakeNumaNodes {
+  explicit FakeNumaNodes(const char* nodes) {
+    setenv(retlock::NumaTopology::FAKE_NODES_ENV, nodes, 1);
+    retlock::NumaTopology::redetect();
+  }
+  ~FakeNumaNodes() {
+    unsetenv(retlock::NumaTopology::FAKE_NODES_ENV);
+    retlock::NumaTopology::redetect();
+  }
+};
+
+/** Test cases for NUMA-aware Locking */
+TEST_SUITE("NUMA-aware Lock" * doctest::description("Topology detection and cohort locking")) {
+  TEST_CASE("fake topology from the environment") {
+    setenv(retlock::NumaTopology::FAKE_NODES_ENV, "4", 1);
+    retlock::NumaTopology topology;
+    unsetenv(retlock::NumaTopology::FAKE_NODES_ENV);
+    CHECK(topology.isFake());
+    CHECK(topology.numNodes() == 4);
+    CHECK(topology.nodeOfCpu(5) == 1);
+    CHECK(topology.currentNode() < 4);
+  }
+
+  TEST_CASE("detected topology") {
+    const auto& topology = retlock::NumaTopology::instance();
+    CHECK(!topology.isFake());
+    CHECK(0 < topology.numNodes());
+    CHECK(topology.currentNode() < topology.numNodes());
+  }
+
+  TEST_CASE("the process-wide topology is detected again") {
+    {
+      FakeNumaNodes fake("2");
+      CHECK(retlock::NumaTopology::instance().isFake());
+      CHECK(retlock::NumaTopology::instance().numNodes() == 2);
+    }
+    CHECK(!retlock::NumaTopology::instance().isFake());
+  }
+
+  TEST_CASE("cohort lock over a fake two-node topology") {
+    // the lock refers to the topology, which must outlive it
+    static_assert(
+        !std::is_constructible_v<retlock::ReTLockCohortImpl<4>, retlock::NumaTopology>);
+    const retlock::NumaTopology topology(2);
+    retlock::ReTLockCohortImpl<4> l(topology);
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&] {
+        for (int j = 0; j < 1000; ++j) {
+          std::unique_lock<retlock::ReTLockCohortImpl<4>> ul(l);
+          std::unique_lock<retlock::ReTLockCohortImpl<4>> ul2(l);
+          counter++;
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(counter == 4000);
+  }
+
+  TEST_CASE("CNA lock over a fake two-node topology") {
+    FakeNumaNodes fake("2");
+    const auto& topology = retlock::NumaTopology::instance();
+    retlock::ReTLockQueueCNA l;
+    size_t counter = 0;
+    std::atomic<uint32_t> on_node[2] = {};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&] {
+        on_node[topology.currentNode()]++;
+        for (int j = 0; j < 1000; ++j) {
+          std::unique_lock<retlock::ReTLockQueueCNA> ul(l);
+          std::unique_lock<retlock::ReTLockQueueCNA> ul2(l);
+          counter++;
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(0 < on_node[0].load());
+    CHECK(0 < on_node[1].load());
+    CHECK(counter == 4000);
+    CHECK(l.try_lock());
+    l.unlock();
+  }
+
+  TEST_CASE("CNA lock drains the secondary queue") {
+    FakeNumaNodes fake("2");
+    const auto& topology = retlock::NumaTopology::instance();
+    REQUIRE(topology.numNodes() == 2);
+    retlock::ReTLockQueueCNA l;
+    std::mutex order_mutex;
+    std::vector<uint32_t> order;
+    l.lock();
+    const auto my_node = topology.currentNode();
+
+    // fake nodes go round-robin by thread, so one of two new threads is local and one remote
+    uint32_t nodes[2];
+    std::atomic<uint32_t> placed(0);
+    std::atomic<bool> go[2] = {};
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 2; ++i) {
+      waiters.emplace_back([&, i] {
+        nodes[i] = topology.currentNode();
+        placed++;
+        while (!go[i].load()) std::this_thread::yield();
+        std::unique_lock<retlock::ReTLockQueueCNA> ul(l);
+        std::lock_guard<std::mutex> guard(order_mutex);
+        order.push_back(nodes[i]);
+      });
+    }
+    while (placed.load() < 2) std::this_thread::yield();
+    REQUIRE(nodes[0] != nodes[1]);
+    const int remote = nodes[0] == my_node ? 1 : 0;
+    go[remote].store(true);
+    while (l.waiters() < 1) std::this_thread::yield();
+    go[1 - remote].store(true);
+    while (l.waiters() < 2) std::this_thread::yield();
+    l.unlock();
+    for (auto& t : waiters) {
+      t.join();
+    }
+
+    // the remote waiter queued first, was passed over into the secondary queue, and still got
+    // the lock once the local one released it
+    REQUIRE(order.size() == 2);
+    CHECK(order[0] == my_node);
+    CHECK(order[1] != my_node);
+    CHECK(l.try_lock());
+    l.unlock();
+  }
+}
+
+/** Test cases for Combining */
+TEST_SUITE("Combining Lock" * doctest::description("Delegated critical sections via execute()")) {
+  TEST_CASE("execute returns the result of the closure") {
+    retlock::CombiningLock l;
+    int value = 0;
+    CHECK(l.execute([&] { return ++value; }) == 1);
+    int& ref = l.execute([&]() -> int& { return value; });
+    CHECK(&ref == &value);
+    l.execute([&] { value++; });
+    CHECK(value == 2);
+  }
+
+  TEST_CASE("nested execute runs inline") {
+    retlock::CombiningLock l;
+    int value = l.execute([&] {
+      l.lock();
+      auto inner = l.execute([&] { return l.execute([] { return 40; }) + 1; });
+      l.unlock();
+      return inner + 1;
+    });
+    CHECK(value == 42);
+  }
+
+  TEST_CASE("exceptions are rethrown to the caller") {
+    retlock::CombiningLock l;
+    bool caught = false;
+    try {
+      l.execute([] { throw std::runtime_error("failure"); });
+    } catch (const std::runtime_error&) {
+      caught = true;
+    }
+    CHECK(caught);
+    CHECK(l.try_lock());
+    l.unlock();
+  }
+
+  TEST_CASE("concurrent executes are serialized") {
+    retlock::CombiningLock l;
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&] {
+        for (int j = 0; j < 1000; ++j) {
+          l.execute([&] { l.execute([&] { counter++; }); });
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(counter == 4000);
+  }
+}
+
+/** Test cases for Shared Locking */
+TEST_SUITE("Shared Lock" * doctest::description("Reentrant reader-writer locking")) {
+  TEST_CASE("shared_lock") {
+    retlock::ReTSharedLock l;
+    std::shared_lock<retlock::ReTSharedLock> sl(l);
+    CHECK(sl.owns_lock());
+    std::shared_lock<retlock::ReTSharedLock> sl2(l);
+    CHECK(sl2.owns_lock());
+    sl2.unlock();
+    sl.unlock();
+    CHECK(l.try_lock());
+    l.unlock();
+  }
+
+  TEST_CASE("readers share, writers exclude") {
+    retlock::ReTSharedLock l;
+    std::atomic<bool> read_locked(false);
+    std::atomic<bool> checked(false);
+    auto reader = std::async(std::launch::async, [&] {
+      std::shared_lock<retlock::ReTSharedLock> sl(l);
+      read_locked.store(true);
+      while (!checked.load()) {
+        std::this_thread::yield();
+      }
+    });
+    while (!read_locked.load()) {
+      std::this_thread::yield();
+    }
+    auto other = std::async(std::launch::async, [&] {
+      CHECK(l.try_lock_shared());
+      l.unlock_shared();
+      CHECK(!l.try_lock());
+    });
+    other.wait();
+    checked.store(true);
+    reader.wait();
+
+    l.lock();
+    auto blocked = std::async(std::launch::async, [&] { return l.try_lock_shared(); });
+    CHECK(!blocked.get());
+    l.unlock();
+  }
+
+  TEST_CASE("shared lock under the exclusive lock") {
+    retlock::ReTSharedLock l;
+    l.lock();
+    l.lock_shared();
+    l.lock();
+    l.unlock();
+    l.unlock_shared();
+    l.lock_shared();
+    l.unlock();
+    // still held shared after the exclusive lock was released
+    auto writer = std::async(std::launch::async, [&] { return l.try_lock(); });
+    CHECK(!writer.get());
+    l.unlock_shared();
+    CHECK(l.try_lock());
+    l.unlock();
+  }
+
+  TEST_CASE("readers and writers") {
+    retlock::ReTSharedLock l;
+    size_t value = 0;
+    std::atomic<bool> torn(false);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&, i] {
+        for (int j = 0; j < 1000; ++j) {
+          if (i == 0 || j % 8 == 0) {
+            std::unique_lock<retlock::ReTSharedLock> ul(l);
+            std::shared_lock<retlock::ReTSharedLock> sl(l);
+            value++;
+            value++;
+          } else {
+            std::shared_lock<retlock::ReTSharedLock> sl(l);
+            std::shared_lock<retlock::ReTSharedLock> sl2(l);
+            if (value % 2 != 0) torn.store(true);
+          }
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(!torn.load());
+    CHECK(value == 2 * (1000 + 3 * 125));
+  }
+}
+
+/** Test cases for Biased Locking */
+/** A reservation word that counts the writes to it */
+struct CountingBiasWord : std::atomic<uint32_t> {
+  using std::atomic<uint32_t>::atomic;
+  inline static size_t writes = 0;
+  bool compare_exchange_strong(uint32_t& expected, uint32_t desired) {
+    writes++;
+    return std::atomic<uint32_t>::compare_exchange_strong(expected, desired);
+  }
+  void store(uint32_t desired, std::memory_order order) {
+    writes++;
+    std::atomic<uint32_t>::store(desired, order);
+  }
+};
+
+/** A fallback lock that counts the calls to it */
+struct CountingFallback : retlock::ReTLockPadding {
+  inline static std::atomic<size_t> calls{0};
+  void lock() {
+    calls++;
+    retlock::ReTLockPadding::lock();
+  }
+  bool try_lock() {
+    calls++;
+    return retlock::ReTLockPadding::try_lock();
+  }
+  void unlock() {
+    calls++;
+    retlock::ReTLockPadding::unlock();
+  }
+};
+
+TEST_SUITE("Biased Lock" * doctest::description("Reservation and revocation")) {
+  TEST_CASE("the owner writes neither the bias word nor the fallback") {
+    using Lock = retlock::ReTLockBiasedImpl<CountingFallback, CountingBiasWord>;
+    Lock l;
+    CountingBiasWord::writes = 0;
+    CountingFallback::calls = 0;
+    // the first acquisition reserves the lock with a CAS
+    l.lock();
+    l.unlock();
+    CHECK(CountingBiasWord::writes == 1);
+    for (int i = 0; i < 1000; ++i) {
+      l.lock();
+      l.lock();
+      CHECK(l.try_lock());
+      l.unlock();
+      l.unlock();
+      l.unlock();
+    }
+    CHECK(CountingBiasWord::writes == 1);
+    CHECK(CountingFallback::calls == 0);
+
+    // a revoker does write both
+    std::async(std::launch::async, [&] {
+      std::lock_guard<Lock> guard(l);
+    }).wait();
+    CHECK(1 < CountingBiasWord::writes);
+    CHECK(0 < CountingFallback::calls.load());
+  }
+
+  TEST_CASE("revocation waits for the owner") {
+    retlock::ReTLockBiased l;
+    l.lock();
+    l.lock();
+    std::atomic<bool> acquired(false);
+    auto other = std::async(std::launch::async, [&] {
+      CHECK(!l.try_lock());
+      std::unique_lock<retlock::ReTLockBiased> ul(l);
+      acquired.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(!acquired.load());
+    l.unlock();
+    l.lock();
+    CHECK(!acquired.load());
+    l.unlock();
+    l.unlock();
+    other.wait();
+    CHECK(acquired.load());
+
+    // revoked: the former owner goes through the ordinary lock
+    l.lock();
+    auto blocked = std::async(std::launch::async, [&] { return l.try_lock(); });
+    CHECK(!blocked.get());
+    l.unlock();
+  }
+
+  TEST_CASE("owner and revokers") {
+    retlock::ReTLockBiased l;
+    size_t counter = 0;
+    for (int j = 0; j < 1000; ++j) {
+      std::unique_lock<retlock::ReTLockBiased> ul(l);
+      counter++;
+    }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&] {
+        for (int j = 0; j < 1000; ++j) {
+          std::unique_lock<retlock::ReTLockBiased> ul(l);
+          std::unique_lock<retlock::ReTLockBiased> ul2(l);
+          counter++;
+        }
+      });
+    }
+    for (int j = 0; j < 1000; ++j) {
+      std::unique_lock<retlock::ReTLockBiased> ul(l);
+      counter++;
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(counter == 6000);
+  }
+}
+
+/** Test cases for Timed Locking */
+TEST_SUITE("Timed Lock" * doctest::description("try_lock_for & try_lock_until")) {
+  TEST_CASE_TEMPLATE("timeout while another thread holds the lock", T, TIMED_LOCK) {
+    T l;
+    std::atomic<bool> locked(false);
+    std::atomic<bool> release(false);
+    auto holder = std::async(std::launch::async, [&] {
+      std::unique_lock<T> ul(l);
+      std::unique_lock<T> ul2(l);
+      locked.store(true);
+      while (!release.load()) {
+        std::this_thread::yield();
+      }
+    });
+    while (!locked.load()) {
+      std::this_thread::yield();
+    }
+
+    std::async(std::launch::async, [&] {
+      CHECK(!l.try_lock_for(std::chrono::milliseconds(5)));
+      CHECK(!l.try_lock_until(std::chrono::steady_clock::now() + std::chrono::milliseconds(5)));
+      release.store(true);
+      holder.wait();
+
+      CHECK(l.try_lock_for(std::chrono::seconds(10)));
+      CHECK(l.try_lock_until(std::chrono::system_clock::now() + std::chrono::seconds(10)));
+      l.unlock();
+      l.unlock();
+    }).wait();
+  }
+
+  TEST_CASE_TEMPLATE("waiters that time out do not block the others", T, TIMED_LOCK) {
+    T l;
+    std::atomic<bool> locked(false);
+    std::atomic<bool> release(false);
+    auto holder = std::async(std::launch::async, [&] {
+      std::unique_lock<T> ul(l);
+      locked.store(true);
+      while (!release.load()) {
+        std::this_thread::yield();
+      }
+    });
+    while (!locked.load()) {
+      std::this_thread::yield();
+    }
+
+    std::atomic<int> timed_out(0);
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 3; ++i) {
+      waiters.emplace_back([&, i] {
+        if (!l.try_lock_for(std::chrono::milliseconds(1 + i))) {
+          timed_out++;
+        } else {
+          l.unlock();
+        }
+      });
+    }
+    std::atomic<bool> acquired(false);
+    auto patient = std::async(std::launch::async, [&] {
+      CHECK(l.try_lock_for(std::chrono::seconds(10)));
+      acquired.store(true);
+      l.unlock();
+    });
+    for (auto& t : waiters) {
+      t.join();
+    }
+    CHECK(timed_out.load() == 3);
+    CHECK(!acquired.load());
+
+    // the next waiter is reached through the abandoned ones
+    release.store(true);
+    holder.wait();
+    patient.wait();
+    CHECK(acquired.load());
+    std::async(std::launch::async, [&] {
+      std::unique_lock<T> ul(l);
+      CHECK(ul.owns_lock());
+    }).wait();
+  }
+}
+
+/** Test cases for the compact lock word */
+TEST_SUITE("Compact Lock" * doctest::description("qspinlock-style four-byte lock word")) {
+  TEST_CASE("holding several locks at once") {
+    static_assert(sizeof(retlock::ReTLockQSpin) == 4);
+    retlock::ReTLockQSpin locks[3];
+    for (auto& l : locks) {
+      l.lock();
+      l.lock();
+    }
+    auto other = std::async(std::launch::async, [&] {
+      for (auto& l : locks) {
+        CHECK(!l.try_lock());
+      }
+    });
+    other.wait();
+    for (auto& l : locks) {
+      l.unlock();
+      l.unlock();
+    }
+    for (auto& l : locks) {
+      CHECK(l.try_lock());
+      l.unlock();
+    }
+  }
+}
+
+/** Test cases for out-of-line recursion counts */
+TEST_SUITE("Held Lock Table" * doctest::description("Thread-local recursion depths")) {
+  TEST_CASE("insert, find and erase across growth") {
+    retlock::HeldLockTable table;
+    std::vector<int> keys(100);
+    for (auto& k : keys) {
+      *table.insert(&k) = 1;
+    }
+    CHECK(table.size() == keys.size());
+    // erase every other key; the rest must still be found after the backward shifts
+    for (size_t i = 0; i < keys.size(); i += 2) {
+      table.erase(&keys[i]);
+    }
+    CHECK(table.size() == keys.size() / 2);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      auto* depth = table.find(&keys[i]);
+      if (i % 2 == 0) {
+        CHECK(depth == nullptr);
+      } else {
+        REQUIRE(depth != nullptr);
+        CHECK(*depth == 1);
+      }
+    }
+  }
+
+  TEST_CASE("the depth is kept in the table of the holder") {
+    static_assert(sizeof(retlock::ReTLockOutOfLine) == 4);
+    retlock::ReTLockOutOfLine l;
+    l.lock();
+    CHECK(*retlock::HeldLockTable::local().find(&l) == 1);
+    l.lock();
+    CHECK(l.try_lock());
+    CHECK(*retlock::HeldLockTable::local().find(&l) == 3);
+    l.unlock();
+    l.unlock();
+    std::async(std::launch::async, [&] { CHECK(!l.try_lock()); }).wait();
+    l.unlock();
+    CHECK(retlock::HeldLockTable::local().find(&l) == nullptr);
+  }
+}
+
+/** Test cases for striped locking */
+TEST_SUITE("Lock Table" * doctest::description("Objects hashed onto a fixed set of locks")) {
+  TEST_CASE("objects sharing a stripe nest on it") {
+    retlock::LockTable<1> table;
+    int a = 0, b = 0;
+    CHECK(table.stripe(&a) == table.stripe(&b));
+    {
+      retlock::LockTable<1>::Guard ga(table, &a);
+      retlock::LockTable<1>::Guard gb(table, &b);
+      table.unlock(&a);
+      // b is still held
+      std::async(std::launch::async, [&] { CHECK(!table.try_lock(&b)); }).wait();
+      table.lock(&a);
+    }
+    std::async(std::launch::async, [&] {
+      CHECK(table.try_lock(&a));
+      table.unlock(&a);
+    }).wait();
+  }
+
+  TEST_CASE("stripes are spread and isolated") {
+    retlock::LockTable<64> table;
+    std::vector<long> objects(1000);
+    std::vector<int> hits(64);
+    for (auto& o : objects) {
+      hits[table.stripe(&o)]++;
+    }
+    for (auto h : hits) {
+      CHECK(0 < h);
+    }
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&] {
+        for (int j = 0; j < 1000; ++j) {
+          auto* o = &objects[j % objects.size()];
+          retlock::LockTable<64>::Guard g(table, o);
+          (*o)++;
+        }
+        std::unique_lock<retlock::ReTLockVanilla> ul(table.get(&counter));
+        counter++;
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (auto o : objects) {
+      CHECK(o == 4);
+    }
+    CHECK(counter == 4);
+  }
+}
+
+/** Test cases for lock inflation */
+TEST_SUITE("Thin Lock" * doctest::description("Inflation to a monitor and deflation")) {
+  TEST_CASE("recursion overflow inflates") {
+    retlock::ReTLockThin l;
+    const auto depth = retlock::ReTLockThin::MAX_COUNT + 10;
+    for (uint32_t i = 0; i < depth; ++i) {
+      l.lock();
+    }
+    CHECK(l.inflated());
+    std::async(std::launch::async, [&] { CHECK(!l.try_lock()); }).wait();
+    for (uint32_t i = 0; i < depth; ++i) {
+      l.unlock();
+    }
+    CHECK(!l.inflated());
+    std::async(std::launch::async, [&] {
+      CHECK(l.try_lock());
+      l.unlock();
+    }).wait();
+  }
+
+  TEST_CASE("recursion overflow without a monitor left fails") {
+    // a pool of a single chunk of 1024 monitors
+    using Lock = retlock::ReTLockThinImpl<64, 1024>;
+    constexpr uint32_t LOCKS = 1025;
+    std::unique_ptr<Lock[]> locks(new Lock[LOCKS]);
+    for (uint32_t i = 0; i < LOCKS; ++i) {
+      for (uint32_t j = 0; j < Lock::MAX_COUNT; ++j) {
+        locks[i].lock();
+      }
+    }
+    for (uint32_t i = 0; i + 1 < LOCKS; ++i) {
+      locks[i].lock();
+      CHECK(locks[i].inflated());
+    }
+    auto& last = locks[LOCKS - 1];
+    CHECK(!last.try_lock());
+    bool thrown = false;
+    try {
+      last.lock();
+    } catch (const std::system_error&) {
+      thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(!last.inflated());
+
+    // a deflated lock frees its monitor
+    for (uint32_t j = 0; j <= Lock::MAX_COUNT; ++j) {
+      locks[0].unlock();
+    }
+    last.lock();
+    CHECK(last.inflated());
+    for (uint32_t i = 1; i < LOCKS; ++i) {
+      for (uint32_t j = 0; j <= Lock::MAX_COUNT; ++j) {
+        locks[i].unlock();
+      }
+    }
+  }
+
+  TEST_CASE("contention inflates, quiet deflates") {
+    retlock::ReTLockThin l;
+    std::atomic<bool> started(false);
+    std::atomic<bool> locked(false);
+    std::atomic<bool> inflated(false);
+    l.lock();
+    auto waiter = std::async(std::launch::async, [&] {
+      started.store(true);
+      l.lock();
+      locked.store(true);
+      // the winner of a contended thin lock inflates it
+      inflated.store(l.inflated());
+      l.unlock();
+    });
+    while (!started.load()) {
+      std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    l.unlock();
+    waiter.wait();
+    CHECK(locked.load());
+    CHECK(inflated.load());
+    CHECK(!l.inflated());
+  }
+
+  TEST_CASE("parked and spinning contenders") {
+    retlock::ReTLockThin l;
+    CHECK(contendNested(l) == 2000);
+    CHECK(!l.inflated());
+  }
+}
+
+/** Policy-based and mode-switching locks */
+using PaddedSpinSeqCst = retlock::BasicReTLock<retlock::PaddedLayout, retlock::SpinWait,
+                                              retlock::InlineCounter, retlock::SeqCstOrder>;
+using SameLineExponentialOutOfLine
+    = retlock::BasicReTLock<retlock::SameLineLayout, retlock::ExponentialWait,
+                            retlock::OutOfLineCounter>;
+using QueueYieldOutOfLine
+    = retlock::BasicReTLock<retlock::QueueLayout, retlock::YieldWait, retlock::OutOfLineCounter>;
+using HybridBothModes = retlock::ReTLockHybridImpl<1, 8>;
+#define CONTENDED_LOCK                                                                            \
+  retlock::ReTLockQSpin, HybridBothModes, PaddedSpinSeqCst, SameLineExponentialOutOfLine,         \
+      QueueYieldOutOfLine, retlock::ReTLockQueueSpin, retlock::ReTLockQueueFutex
+
+/** Test cases for nested acquisitions under contention */
+TEST_SUITE("Contended Lock" * doctest::description("Waiters in every mode of a lock")) {
+  TEST_CASE_TEMPLATE("nested and contended", T, CONTENDED_LOCK) {
+    T l;
+    CHECK(contendNested(l) == 2000);
+  }
+}
+
+/** Test cases for mode switching */
+TEST_SUITE("Hybrid Lock" * doctest::description("Test-and-set and queued modes")) {
+  TEST_CASE("contention turns queued, quiet turns back") {
+    // switch on the first contended acquisition, back after 4 quiet ones
+    using Lock = retlock::ReTLockHybridImpl<0, 4>;
+    Lock l;
+    CHECK(!l.queued());
+    l.lock();
+    auto waiter = std::async(std::launch::async, [&] {
+      std::unique_lock<Lock> ul(l);
+      std::unique_lock<Lock> ul2(l);
+    });
+    while (!l.queued()) {
+      std::this_thread::yield();
+    }
+    l.unlock();
+    waiter.wait();
+    // the waiter's acquisition was the first quiet one
+    for (int i = 0; i < 2; ++i) {
+      std::unique_lock<Lock> ul(l);
+      CHECK(l.queued());
+    }
+    { std::unique_lock<Lock> ul(l); }
+    CHECK(!l.queued());
+  }
+}
+
+/** Test cases for arena-allocated locks */
+struct CountedLock : retlock::ReTLockVanilla {
+  static std::atomic<int> alive;
+  CountedLock() { alive++; }
+  ~CountedLock() { alive--; }
+};
+std::atomic<int> CountedLock::alive(0);
+
+TEST_SUITE("Lock Arena" * doctest::description("Cache-line slots from per-node slabs")) {
+  TEST_CASE_TEMPLATE("slots are aligned and reused", T, retlock::ReTLockPadding,
+                     retlock::ReTLockVanilla, retlock::ReTLockQueue, retlock::ReTLockQSpin) {
+    retlock::LockArena<T, 8> arena;
+    std::vector<T*> locks;
+    for (int i = 0; i < 20; ++i) {
+      auto* l = arena.create();
+      CHECK(reinterpret_cast<uintptr_t>(l) % 64 == 0);
+      locks.push_back(l);
+    }
+    CHECK(arena.size() == 20);
+    for (size_t i = 1; i < locks.size(); ++i) {
+      auto distance = reinterpret_cast<intptr_t>(locks[i]) - reinterpret_cast<intptr_t>(locks[0]);
+      CHECK(distance % 64 == 0);
+    }
+    std::unique_lock<T> ul(*locks[3]);
+    ul.unlock();
+    auto* freed = locks.back();
+    arena.destroy(freed);
+    CHECK(arena.create() == freed);
+  }
+
+  TEST_CASE("per-node slabs and bulk free") {
+    retlock::LockArena<CountedLock, 4> arena(retlock::NumaTopology(4));
+    std::vector<std::pair<CountedLock*, uint32_t>> created(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < created.size(); ++i) {
+      threads.emplace_back([&, i] {
+        auto* l = arena.create();
+        created[i] = {l, retlock::NumaTopology(4).currentNode()};
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (auto& [l, node] : created) {
+      CHECK(arena.nodeOf(l) == node);
+    }
+    CHECK(CountedLock::alive.load() == 8);
+    arena.clear();
+    CHECK(CountedLock::alive.load() == 0);
+    CHECK(arena.size() == 0);
+  }
+}
+
+/** Test cases for the pause backoff */
+TEST_SUITE("Backoff" * doctest::description("Calibrated, capped pause backoff")) {
+  TEST_CASE("calibration is positive and stable") {
+    const auto nanos = retlock::detail::nanosPerPause();
+    CHECK(0 < nanos);
+    CHECK(nanos == retlock::detail::nanosPerPause());
+  }
+
+  TEST_CASE("late attempts stay capped") {
+    using Backoff = retlock::PauseBackoff<32, 1024>;
+    // an uncapped 1 << i would overflow long before this
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 60; i < 160; ++i) {
+      Backoff::pause(i);
+    }
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+  }
+
+  TEST_CASE_TEMPLATE("exponential sleeps stay capped", T, retlock::ReTLockVanilla,
+                     retlock::ReTLockPadding) {
+    T lock;
+    lock.lock();
+    auto waiter = std::async(std::launch::async, [&] {
+      std::lock_guard<T> guard(lock);
+      return std::chrono::steady_clock::now();
+    });
+    // long enough for a few hundred retries, i.e. shifts far beyond 31
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    const auto release = std::chrono::steady_clock::now();
+    lock.unlock();
+    // an uncapped waiter would sleep for a second or more before it notices
+    CHECK(waiter.get() - release < std::chrono::milliseconds(100));
+  }
+}
+
+/** Test cases for concurrency restriction */
+TEST_SUITE("Malthusian Lock" * doctest::description("A capped active set and a passive set")) {
+  TEST_CASE("threads beyond the cap turn passive") {
+    using Lock = retlock::ReTLockMalthusianImpl<retlock::ReTLockNoSleepPadding, 1>;
+    Lock lock;
+    int counter = 0;
+    lock.lock();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+      threads.emplace_back([&] {
+        std::lock_guard<Lock> guard(lock);
+        counter++;
+      });
+    }
+    while (lock.passive() < 3) {
+      std::this_thread::yield();
+    }
+    CHECK(!std::async(std::launch::async, [&] { return lock.try_lock(); }).get());
+    lock.unlock();
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(lock.passive() == 0);
+    CHECK(counter == 3);
+  }
+
+  TEST_CASE("rotation keeps every thread going") {
+    using Lock = retlock::ReTLockMalthusianImpl<retlock::ReTLockQueue, 2, 1>;
+    Lock lock;
+    int counter = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 6; ++i) {
+      threads.emplace_back([&] {
+        for (int j = 0; j < 500; ++j) {
+          std::lock_guard<Lock> guard(lock);
+          std::lock_guard<Lock> nested(lock);
+          counter++;
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(counter == 3000);
+    CHECK(lock.passive() == 0);
+  }
+
+  TEST_CASE("passive threads that exit") {
+    // every release hands over to a passive thread, which may exit before the wake-up lands
+    using Lock = retlock::ReTLockMalthusianImpl<retlock::ReTLockQueue, 1, 1>;
+    Lock lock;
+    int counter = 0;
+    for (int round = 0; round < 20; ++round) {
+      std::vector<std::thread> threads;
+      for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+          for (int j = 0; j < 10; ++j) {
+            std::lock_guard<Lock> guard(lock);
+            counter++;
+          }
+        });
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+    }
+    CHECK(counter == 800);
+    CHECK(lock.passive() == 0);
+  }
+}
+
+/** Test cases for adaptive waiting */
+/** A clock that only moves when told to */
+struct ManualClock {
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<ManualClock>;
+  static constexpr bool is_steady = true;
+  inline static std::atomic<rep> nanos{0};
+  static time_point now() { return time_point(duration(nanos.load())); }
+};
+
+TEST_SUITE("Adaptive Lock" * doctest::description("Hold hints published by the owner")) {
+  TEST_CASE("hint follows the hold times") {
+    using Lock = retlock::ReTLockImpl<retlock::SleepType::Adaptive, ManualClock>;
+    Lock lock;
+    CHECK(lock.expectedHold() == 0);
+    // four timed holds of 2^20 ns each
+    for (uint32_t i = 0; i < 4 * Lock::HOLD_SAMPLE_EVERY; ++i) {
+      std::lock_guard<Lock> guard(lock);
+      ManualClock::nanos += 1 << 20;
+    }
+    CHECK(lock.expectedHold() == 0);
+    lock.lock();
+    // the EWMA with weight 1/8 has reached 1 - (7/8)^4 of 2^20 ns, i.e. 433920 ns
+    const auto hold = lock.expectedHold();
+    CHECK(hold == 18);
+    lock.lock();
+    CHECK(lock.expectedHold() == hold + 1);
+    lock.lock();
+    CHECK(lock.expectedHold() == hold + 1);
+    lock.lock();
+    CHECK(lock.expectedHold() == hold + 2);
+    lock.unlock();
+    CHECK(lock.expectedHold() == hold + 1);
+    lock.unlock();
+    lock.unlock();
+    CHECK(lock.expectedHold() == hold);
+    lock.unlock();
+    CHECK(lock.expectedHold() == 0);
+  }
+
+  TEST_CASE("other sleep types publish no hint") {
+    retlock::ReTLockPadding lock;
+    std::lock_guard<retlock::ReTLockPadding> guard(lock);
+    std::lock_guard<retlock::ReTLockPadding> nested(lock);
+    CHECK(lock.expectedHold() == 0);
+  }
+}
+
+/** Test cases for the thread registry */
+TEST_SUITE("Thread Registry" * doctest::description("Dense, recycled thread ids")) {
+  TEST_CASE("ids are unique among live threads") {
+    const auto my_id = retlock::ThreadRegistry::currentId();
+    CHECK(my_id != retlock::ThreadRegistry::INVALID_ID);
+    CHECK(my_id == retlock::getThreadId());
+
+    std::atomic<int> ready(0);
+    std::atomic<bool> done(false);
+    std::vector<uint32_t> ids(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < ids.size(); ++i) {
+      threads.emplace_back([&, i] {
+        ids[i] = retlock::getThreadId();
+        ready++;
+        while (!done.load()) {
+          std::this_thread::yield();
+        }
+      });
+    }
+    while (ready.load() < static_cast<int>(ids.size())) {
+      std::this_thread::yield();
+    }
+    ids.push_back(my_id);
+    for (size_t i = 0; i < ids.size(); ++i) {
+      CHECK(0 < ids[i]);
+      CHECK(ids[i] <= retlock::ThreadRegistry::maxId());
+      for (size_t j = 0; j < i; ++j) {
+        CHECK(ids[i] != ids[j]);
+      }
+    }
+    done.store(true);
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  TEST_CASE("ids are recycled on thread exit") {
+    retlock::getThreadId();
+    std::thread([] { retlock::getThreadId(); }).join();
+    const auto max_id = retlock::ThreadRegistry::maxId();
+    for (int i = 0; i < 100; ++i) {
+      std::thread([&] { CHECK(retlock::getThreadId() <= max_id); }).join();
+    }
+    CHECK(retlock::ThreadRegistry::maxId() == max_id);
+  }
+
+  TEST_CASE("blocking regions clear the running flag") {
+    const auto my_id = retlock::getThreadId();
+    CHECK(retlock::ThreadRegistry::isRunning(my_id));
+    {
+      retlock::BlockingRegion blocked;
+      CHECK(!retlock::ThreadRegistry::isRunning(my_id));
+      {
+        retlock::BlockingRegion nested;
+        CHECK(!retlock::ThreadRegistry::isRunning(my_id));
+      }
+      CHECK(!retlock::ThreadRegistry::isRunning(my_id));
+    }
+    CHECK(retlock::ThreadRegistry::isRunning(my_id));
+    CHECK(retlock::ThreadRegistry::isRunning(retlock::ThreadRegistry::INVALID_ID));
+  }
+
+  TEST_CASE_TEMPLATE("waiters behind a blocked owner get the lock", T,
+                     retlock::ReTLockSameLineOwnerAware, retlock::ReTLockQueueOwnerAware) {
+    T lock;
+    std::atomic<bool> blocked(false);
+    std::atomic<bool> acquired(false);
+    std::thread owner([&] {
+      std::lock_guard<T> guard(lock);
+      retlock::BlockingRegion region;
+      blocked.store(true);
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      CHECK(!acquired.load());
+    });
+    while (!blocked.load()) {
+      std::this_thread::yield();
+    }
+    {
+      std::lock_guard<T> guard(lock);
+      acquired.store(true);
+    }
+    owner.join();
+  }
+}
+
+/** Test cases for queue locks held together */
+TEST_SUITE("Queue Nodes" * doctest::description("One queue node per held lock instance")) {
+  TEST_CASE_TEMPLATE("holding several instances at once", T, QUEUE_LOCK) {
+    T locks[4];
+    for (auto& l : locks) {
+      l.lock();
+    }
+    locks[2].lock();
+    std::async(std::launch::async, [&] {
+      for (auto& l : locks) {
+        CHECK(!l.try_lock());
+      }
+    }).wait();
+
+    // release out of order
+    locks[1].unlock();
+    locks[2].unlock();
+    locks[3].unlock();
+    locks[2].unlock();
+    std::async(std::launch::async, [&] {
+      CHECK(!locks[0].try_lock());
+      for (size_t i = 1; i < 4; ++i) {
+        CHECK(locks[i].try_lock());
+        locks[i].unlock();
+      }
+    }).wait();
+    locks[0].unlock();
+  }
+
+  TEST_CASE_TEMPLATE("nested acquisition under contention", T, QUEUE_LOCK) {
+    T outer;
+    T inner[2];
+    size_t counters[2] = {0, 0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+      threads.emplace_back([&] {
+        for (int j = 0; j < 300; ++j) {
+          std::unique_lock<T> ul(outer);
+          std::unique_lock<T> ul2(inner[j % 2]);
+          std::unique_lock<T> ul3(inner[(j + 1) % 2]);
+          counters[j % 2]++;
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(counters[0] + counters[1] == 900);
+  }
+
+  TEST_CASE_TEMPLATE("try_lock racing with lock", T, QUEUE_LOCK) {
+    // try_lock() leaves the queue when it finds the lock taken, and waiters behind it move on
+    T l;
+    size_t counter = 0;
+    std::atomic<size_t> acquired(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&, i] {
+        for (int j = 0; j < 500; ++j) {
+          if ((i + j) % 2 == 0) {
+            std::unique_lock<T> ul(l);
+            counter++;
+            acquired++;
+          } else if (l.try_lock()) {
+            counter++;
+            acquired++;
+            l.unlock();
+          }
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    CHECK(counter == acquired.load());
+    CHECK(1000 <= counter);
+  }
+}
+
+/** Test cases for thread churn */
+TEST_SUITE("Thread Exit" * doctest::description("Queue nodes outlive the threads using them")) {
+  TEST_CASE_TEMPLATE("short-lived threads", T, QUEUE_LOCK) {
+    T l;
+    size_t counter = 0;
+    std::atomic<bool> done(false);
+    // try_lock() may read the node of an exited thread through the tail
+    auto prober = std::async(std::launch::async, [&] {
+      while (!done.load()) {
+        if (l.try_lock()) {
+          counter++;
+          l.unlock();
+        }
+        std::this_thread::yield();
+      }
+    });
+    size_t expected = 0;
+    for (int round = 0; round < 20; ++round) {
+      std::vector<std::thread> threads;
+      for (int i = 0; i < 3; ++i) {
+        threads.emplace_back([&] {
+          for (int j = 0; j < 20; ++j) {
+            std::unique_lock<T> ul(l);
+            counter++;
+          }
+        });
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+      expected += 3 * 20;
+    }
+    done.store(true);
+    prober.wait();
+    std::unique_lock<T> ul(l);
+    CHECK(expected <= counter);
+  }
+}